@@ -0,0 +1,46 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_CACHEDIR_H_
+#define _INCLUDE_SRCDS_CACHEDIR_H_
+
+#include <errno.h>
+#include <sys/stat.h>
+
+// Directory in the working directory that holds the cache files. Keeping them out of the working
+// directory itself means writing them doesn't change its modification time, which GameIndex uses
+// (and watches) to tell when game directories have been added or removed.
+#define SRCDS_CACHE_DIR ".srcds_cache"
+
+// Creates the cache directory if it doesn't exist yet
+inline bool MakeCacheDir()
+{
+    return mkdir(SRCDS_CACHE_DIR, 0755) == 0 || errno == EEXIST;
+}
+
+#endif // _INCLUDE_SRCDS_CACHEDIR_H_
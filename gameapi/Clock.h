@@ -0,0 +1,94 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_CLOCK_H_
+#define _INCLUDE_SRCDS_CLOCK_H_
+
+#include <stdint.h>
+#include "platform.h"
+
+#if defined(PLATFORM_MACOSX)
+#include <mach/mach_time.h>
+#else
+#include <errno.h>
+#include <time.h>
+#endif
+
+#if defined(PLATFORM_MACOSX)
+// Returns the conversion factor between mach_absolute_time() ticks and nanoseconds
+inline const mach_timebase_info_data_t &ClockTimebase()
+{
+    static mach_timebase_info_data_t timebase;
+    
+    if (timebase.denom == 0)
+        mach_timebase_info(&timebase);
+    
+    return timebase;
+}
+#endif
+
+// Returns a monotonic timestamp in nanoseconds
+inline uint64_t ClockNanos()
+{
+#if defined(PLATFORM_MACOSX)
+    const mach_timebase_info_data_t &timebase = ClockTimebase();
+    uint64_t ticks = mach_absolute_time();
+    
+    // Ticks are nanoseconds on Intel Macs, so avoid the multiplication if possible
+    if (timebase.numer == timebase.denom)
+        return ticks;
+    
+    return ticks * timebase.numer / timebase.denom;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+// Sleeps until the given ClockNanos() timestamp. The wakeup can be late by the scheduler's latency.
+inline void ClockSleepUntil(uint64_t nanos)
+{
+#if defined(PLATFORM_MACOSX)
+    const mach_timebase_info_data_t &timebase = ClockTimebase();
+    
+    if (timebase.numer == timebase.denom)
+        mach_wait_until(nanos);
+    else
+        mach_wait_until(nanos * timebase.denom / timebase.numer);
+#else
+    struct timespec ts;
+    ts.tv_sec = nanos / 1000000000;
+    ts.tv_nsec = nanos % 1000000000;
+    
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+        ;
+#endif
+}
+
+#endif // _INCLUDE_SRCDS_CLOCK_H_
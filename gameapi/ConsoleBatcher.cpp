@@ -0,0 +1,125 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <string.h>
+#include "ConsoleBatcher.h"
+#include "Clock.h"
+
+// Longest time that output waits for the end of a frame with CONSOLE_BATCH_FRAME
+static const uint64_t kMaxFrameWaitNanos = 50000000;
+
+ConsoleBatcher::ConsoleBatcher()
+    : window_(CONSOLE_BATCH_NONE),
+      firstOutput_(0),
+      length_(0),
+      lineCount_(0),
+      lineOpen_(false)
+{
+
+}
+
+void ConsoleBatcher::SetWindow(unsigned int micros)
+{
+    window_ = micros;
+}
+
+bool ConsoleBatcher::IsEnabled() const
+{
+    return window_ != CONSOLE_BATCH_NONE;
+}
+
+void ConsoleBatcher::Append(IGameListener *listener, const char *msg)
+{
+    while (*msg)
+    {
+        if (length_ == 0)
+            firstOutput_ = ClockNanos();
+        
+        if (!lineOpen_)
+        {
+            // The rest of the output starts a new batch, which is timed from now
+            if (lineCount_ == kMaxLines)
+            {
+                Flush(listener);
+                firstOutput_ = ClockNanos();
+            }
+            
+            lines_[lineCount_++] = length_;
+            lineOpen_ = true;
+        }
+        
+        // Copy up to the end of the line or as much as fits, leaving room for the terminator
+        const char *newline = strchr(msg, '\n');
+        size_t len = newline ? newline - msg + 1 : strlen(msg);
+        size_t space = kMaxText - 1 - length_;
+        
+        if (len > space)
+            len = space;
+        
+        memcpy(&text_[length_], msg, len);
+        length_ += len;
+        msg += len;
+        
+        if (text_[length_ - 1] == '\n')
+            lineOpen_ = false;
+        
+        if (length_ == kMaxText - 1)
+            Flush(listener);
+    }
+}
+
+bool ConsoleBatcher::FlushIfDue(IGameListener *listener, bool frameEnd)
+{
+    if (length_ == 0)
+        return false;
+    
+    uint64_t waited = ClockNanos() - firstOutput_;
+    bool due;
+    
+    if (window_ == CONSOLE_BATCH_FRAME)
+        due = frameEnd || waited >= kMaxFrameWaitNanos;
+    else
+        due = waited >= uint64_t(window_) * 1000;
+    
+    return due && Flush(listener);
+}
+
+bool ConsoleBatcher::Flush(IGameListener *listener)
+{
+    if (length_ == 0)
+        return false;
+    
+    text_[length_] = '\0';
+    listener->OnConsoleOutputBatch(text_, length_, lines_, lineCount_);
+    
+    length_ = 0;
+    lineCount_ = 0;
+    lineOpen_ = false;
+    
+    return true;
+}
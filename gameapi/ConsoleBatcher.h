@@ -0,0 +1,71 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_CONSOLEBATCHER_H_
+#define _INCLUDE_SRCDS_CONSOLEBATCHER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "IGameAPI.h"
+
+// Gathers console messages into one contiguous block so the listener can handle a whole batch with
+// a single IGameListener::OnConsoleOutputBatch call instead of one call per message.
+class ConsoleBatcher
+{
+public:
+    ConsoleBatcher();
+    
+    // Sets how long output is gathered, in microseconds, or one of the CONSOLE_BATCH_* values
+    void SetWindow(unsigned int micros);
+    bool IsEnabled() const;
+    
+    // Adds a message. Delivers the batch first if the message doesn't fit.
+    void Append(IGameListener *listener, const char *msg);
+    
+    // Delivers the batch if its window has elapsed. With CONSOLE_BATCH_FRAME, that is at the end of
+    // a frame or if output has been waiting for a long time (i.e. while a map is loading). Without
+    // frames or new output, this only happens when IGameAPI::FlushConsoleOutput is called.
+    bool FlushIfDue(IGameListener *listener, bool frameEnd);
+    
+    // Delivers the batch right away. Returns false if there was nothing to deliver.
+    bool Flush(IGameListener *listener);
+private:
+    static const size_t kMaxText = 65536;
+    static const size_t kMaxLines = 4096;
+    
+    unsigned int window_;
+    uint64_t firstOutput_;      // When the oldest message in the batch arrived
+    
+    char text_[kMaxText];
+    size_t length_;
+    uint32_t lines_[kMaxLines]; // Offset of each line in text_
+    size_t lineCount_;
+    bool lineOpen_;             // The last line hasn't ended yet
+};
+
+#endif // _INCLUDE_SRCDS_CONSOLEBATCHER_H_
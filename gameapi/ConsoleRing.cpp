@@ -0,0 +1,158 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <string.h>
+#include "ConsoleRing.h"
+
+// Keeps the compiler from moving memory accesses across this point. x86 doesn't reorder stores
+// with other stores or loads with other loads, so that's enough for one writer and many readers.
+#define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+ConsoleRing::ConsoleRing()
+    : writeSeq_(0),
+      writeMsg_(0)
+{
+    // Make sure no slot looks like it holds message 0 yet
+    for (uint32_t i = 0; i < kSlots; i++)
+        slots_[i].seq = ~0U;
+}
+
+void ConsoleRing::Write(const char *msg)
+{
+    size_t remaining = strlen(msg);
+    uint32_t seq = writeSeq_;
+    uint32_t number = writeMsg_++;
+    bool first = true;
+    
+    do
+    {
+        Slot &slot = slots_[seq & (kSlots - 1)];
+        size_t len = remaining < kSlotText ? remaining : kSlotText;
+        
+        // Claim the slot before touching its text so readers of the old message notice
+        slot.seq = seq;
+        COMPILER_BARRIER();
+        
+        memcpy(slot.text, msg, len);
+        slot.msg = number;
+        slot.length = len;
+        slot.first = first;
+        
+        // Readers don't look at the slot until the write sequence has passed it
+        COMPILER_BARRIER();
+        writeSeq_ = ++seq;
+        
+        msg += len;
+        remaining -= len;
+        first = false;
+    } while (remaining > 0);
+}
+
+uint32_t ConsoleRing::GetWriteSeq() const
+{
+    return writeSeq_;
+}
+
+console_cursor_t ConsoleRing::GetWriteCursor() const
+{
+    console_cursor_t cursor;
+    cursor.seq = writeSeq_;
+    cursor.msg = writeMsg_;
+    
+    return cursor;
+}
+
+size_t ConsoleRing::Read(console_cursor_t *cursor, char *buffer, size_t maxlength,
+                         uint32_t *dropped) const
+{
+    uint32_t pos = cursor->seq;
+    uint32_t next = cursor->msg;
+    size_t len = 0;
+    *dropped = 0;
+    
+    while (true)
+    {
+        uint32_t end = writeSeq_;
+        
+        if (pos == end)
+            break;
+        
+        // Skip whatever has already been overwritten. The missed messages are counted from the
+        // message numbers once a slot can be read.
+        if (end - pos > kSlots)
+            pos = end - kSlots;
+        
+        COMPILER_BARRIER();
+        
+        const Slot &slot = slots_[pos & (kSlots - 1)];
+        uint32_t seq = slot.seq;
+        uint32_t msg = slot.msg;
+        bool first = slot.first != 0;
+        size_t length = slot.length;
+        
+        COMPILER_BARRIER();
+        
+        if (length < maxlength)
+            memcpy(buffer, slot.text, length);
+        
+        COMPILER_BARRIER();
+        
+        // If the writer claimed the slot in the meantime, the copy may be torn
+        if (seq != pos || slot.seq != seq)
+        {
+            ++pos;
+            continue;
+        }
+        
+        if (length >= maxlength)
+            break;
+        
+        // Every message between the last one started and this one was lost. A piece from the
+        // middle of a message whose start was lost counts as the whole message.
+        if (first || msg != next - 1)
+        {
+            *dropped += msg - next + (first ? 0 : 1);
+            next = msg + 1;
+            
+            if (!first)
+            {
+                ++pos;
+                continue;
+            }
+        }
+        
+        buffer[length] = '\0';
+        len = length;
+        ++pos;
+        break;
+    }
+    
+    cursor->seq = pos;
+    cursor->msg = next;
+    return len;
+}
@@ -0,0 +1,81 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_CONSOLERING_H_
+#define _INCLUDE_SRCDS_CONSOLERING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "IGameAPI.h"
+
+// Fixed-size buffer of recent console output. The engine thread writes messages into numbered
+// slots without ever blocking or allocating, overwriting the oldest ones once the buffer is full.
+// Any number of readers can follow along at their own pace, each with its own cursor (the sequence
+// number of the next message to read). Readers that fall too far behind are told how many messages
+// they missed.
+//
+// Messages longer than a slot are split across several slots. Every slot records the number of the
+// message it belongs to, so readers count missed messages rather than slots.
+class ConsoleRing
+{
+public:
+    static const size_t kSlotText = 244;
+    static const uint32_t kSlots = 8192;
+public:
+    ConsoleRing();
+    
+    // Adds a message. Only to be called from the engine thread.
+    void Write(const char *msg);
+    
+    // Sequence number that the next slot will get
+    uint32_t GetWriteSeq() const;
+    
+    // Cursor that starts reading at the next message to be written. Only exact on the engine thread.
+    console_cursor_t GetWriteCursor() const;
+    
+    // Copies the slot at *cursor into buffer and advances the cursor past it. Returns the length of
+    // the text, or 0 if there is nothing new or the text doesn't fit into maxlength (the cursor then
+    // stays on it). *dropped is set to the number of messages that were overwritten before they
+    // could be read, including ones of which only the start was lost.
+    size_t Read(console_cursor_t *cursor, char *buffer, size_t maxlength, uint32_t *dropped) const;
+private:
+    struct Slot
+    {
+        volatile uint32_t seq;  // Sequence number of this slot
+        uint32_t msg;           // Number of the message that this slot belongs to
+        uint16_t length;
+        uint16_t first;         // Whether this slot holds the start of its message
+        char text[kSlotText];
+    };
+    
+    Slot slots_[kSlots];
+    volatile uint32_t writeSeq_;
+    uint32_t writeMsg_;
+};
+
+#endif // _INCLUDE_SRCDS_CONSOLERING_H_
@@ -0,0 +1,198 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "DirScan.h"
+
+#if defined(PLATFORM_LINUX)
+#include <stdint.h>
+#include <sys/syscall.h>
+
+// Layout of the records returned by getdents64()
+struct linux_dirent64_t
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif
+
+// Directory counts below this aren't worth starting threads for
+#define PARALLEL_MIN_COUNT 8
+
+#if defined(PLATFORM_LINUX)
+
+DirReader::DirReader() : fd_(-1), buffer_(nullptr), length_(0), offset_(0)
+{
+
+}
+
+DirReader::~DirReader()
+{
+    Close();
+    free(buffer_);
+}
+
+bool DirReader::Open(const char *path)
+{
+    Close();
+    
+    if (!buffer_ && (buffer_ = (char *)malloc(DIRSCAN_BUFFER_SIZE)) == nullptr)
+        return false;
+    
+    fd_ = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    length_ = 0;
+    offset_ = 0;
+    
+    return fd_ != -1;
+}
+
+const char *DirReader::Next(unsigned char *type)
+{
+    if (fd_ == -1)
+        return nullptr;
+    
+    if (offset_ >= length_)
+    {
+        length_ = syscall(SYS_getdents64, fd_, buffer_, DIRSCAN_BUFFER_SIZE);
+        offset_ = 0;
+        
+        if (length_ <= 0)
+        {
+            length_ = 0;
+            return nullptr;
+        }
+    }
+    
+    linux_dirent64_t *ent = (linux_dirent64_t *)(buffer_ + offset_);
+    offset_ += ent->d_reclen;
+    
+    *type = ent->d_type;
+    return ent->d_name;
+}
+
+void DirReader::Close()
+{
+    if (fd_ != -1)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+#else
+
+DirReader::DirReader() : dir_(nullptr)
+{
+
+}
+
+DirReader::~DirReader()
+{
+    Close();
+}
+
+bool DirReader::Open(const char *path)
+{
+    Close();
+    
+    dir_ = opendir(path);
+    
+    return dir_ != nullptr;
+}
+
+const char *DirReader::Next(unsigned char *type)
+{
+    if (!dir_)
+        return nullptr;
+    
+    struct dirent *ent = readdir(dir_);
+    
+    if (!ent)
+        return nullptr;
+    
+    *type = ent->d_type;
+    return ent->d_name;
+}
+
+void DirReader::Close()
+{
+    if (dir_)
+    {
+        closedir(dir_);
+        dir_ = nullptr;
+    }
+}
+
+#endif
+
+struct parallel_work_t
+{
+    ParallelFn func;
+    void *data;
+    size_t count;
+    volatile size_t next;
+};
+
+static void *ParallelWorker(void *param)
+{
+    parallel_work_t *work = (parallel_work_t *)param;
+    size_t index;
+    
+    while ((index = __sync_fetch_and_add(&work->next, 1)) < work->count)
+        work->func(work->data, index);
+    
+    return nullptr;
+}
+
+void ParallelFor(size_t count, ParallelFn func, void *data)
+{
+    parallel_work_t work = {func, data, count, 0};
+    pthread_t threads[DIRSCAN_THREADS - 1];
+    int threadCount = 0;
+    
+    if (count >= PARALLEL_MIN_COUNT)
+    {
+        for (int i = 0; i < DIRSCAN_THREADS - 1; i++)
+        {
+            if (pthread_create(&threads[threadCount], nullptr, ParallelWorker, &work) == 0)
+                threadCount++;
+        }
+    }
+    
+    // The calling thread works too, which also covers threads that couldn't be created
+    ParallelWorker(&work);
+    
+    for (int i = 0; i < threadCount; i++)
+        pthread_join(threads[i], nullptr);
+}
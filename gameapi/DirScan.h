@@ -0,0 +1,76 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_DIRSCAN_H_
+#define _INCLUDE_SRCDS_DIRSCAN_H_
+
+#include <stddef.h>
+#include <dirent.h>
+#include "platform.h"
+
+// Number of threads ParallelFor uses, including the calling thread
+#define DIRSCAN_THREADS 4
+
+// Size of the buffer each DirReader reads directory entries into on Linux
+#define DIRSCAN_BUFFER_SIZE (32 * 1024)
+
+// Reads the entries of a directory without going through the engine filesystem. On Linux this
+// uses getdents64() directly with a large buffer, so a big directory takes a handful of system
+// calls; elsewhere it uses readdir().
+class DirReader
+{
+public:
+    DirReader();
+    ~DirReader();
+    
+    bool Open(const char *path);
+    
+    // Returns the name of the next entry (including "." and ".."), or nullptr at the end of the
+    // directory. *type is a DT_* value, which is DT_UNKNOWN if the file system doesn't keep them.
+    const char *Next(unsigned char *type);
+    
+    void Close();
+private:
+#if defined(PLATFORM_LINUX)
+    int fd_;
+    char *buffer_;
+    long length_;
+    long offset_;
+#else
+    DIR *dir_;
+#endif
+};
+
+typedef void (*ParallelFn)(void *data, size_t index);
+
+// Calls func(data, i) for every i below count on up to DIRSCAN_THREADS threads, and returns once
+// all of them are done. Threads take the next index whenever they finish one, so a few slow
+// directories don't hold up the rest. Small counts are run on the calling thread.
+void ParallelFor(size_t count, ParallelFn func, void *data);
+
+#endif // _INCLUDE_SRCDS_DIRSCAN_H_
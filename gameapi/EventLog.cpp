@@ -0,0 +1,271 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include "EventLog.h"
+#include "Clock.h"
+#include "stringutil.h"
+
+static inline size_t AlignRecord(size_t size)
+{
+    return (size + EVENTLOG_ALIGN - 1) & ~size_t(EVENTLOG_ALIGN - 1);
+}
+
+EventLog::EventLog(ErrorReporter *reporter)
+    : reporter_(reporter),
+      fd_(-1),
+      indexFd_(-1),
+      segment_(nullptr),
+      segmentStart_(0),
+      segmentUsed_(0),
+      nextIndex_(0),
+      clockBase_(0),
+      lock_(0)
+{
+    path_[0] = '\0';
+}
+
+EventLog::~EventLog()
+{
+    Close();
+}
+
+void EventLog::ParseOptions(int argc, char *argv[])
+{
+    for (int i = 0; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-eventlog") == 0)
+            strncopy(path_, argv[++i], sizeof(path_));
+    }
+}
+
+bool EventLog::IsEnabled() const
+{
+    return segment_ != nullptr;
+}
+
+bool EventLog::Open()
+{
+    char indexPath[1100];
+    
+    if (!path_[0] || segment_)
+        return segment_ != nullptr;
+    
+    fd_ = open(path_, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ == -1)
+    {
+        reporter_->Warning("Failed to open event log %s: %s\n", path_, strerror(errno));
+        return false;
+    }
+    
+    snprintf(indexPath, sizeof(indexPath), "%s.idx", path_);
+    indexFd_ = open(indexPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    
+    if (indexFd_ == -1 || !MapSegment(0))
+    {
+        reporter_->Warning("Failed to set up event log %s: %s\n", path_, strerror(errno));
+        CloseFiles();
+        return false;
+    }
+    
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    clockBase_ = ClockNanos();
+    
+    eventlog_header_t *header = (eventlog_header_t *)segment_;
+    memcpy(header->magic, EVENTLOG_MAGIC, sizeof(header->magic));
+    header->version = EVENTLOG_VERSION;
+    header->segmentSize = EVENTLOG_SEGMENT_SIZE;
+    header->startTime = uint64_t(now.tv_sec) * 1000000000 + uint64_t(now.tv_usec) * 1000;
+    
+    segmentUsed_ = AlignRecord(sizeof(eventlog_header_t));
+    nextIndex_ = 0;
+    
+    return true;
+}
+
+void EventLog::Close()
+{
+    while (__sync_lock_test_and_set(&lock_, 1))
+        __asm__ __volatile__("pause");
+    
+    CloseFiles();
+    
+    __sync_lock_release(&lock_);
+}
+
+void EventLog::CloseFiles()
+{
+    if (segment_)
+    {
+        munmap(segment_, EVENTLOG_SEGMENT_SIZE);
+        segment_ = nullptr;
+        
+        // Trim the unused part of the last segment
+        if (ftruncate(fd_, segmentStart_ + segmentUsed_) != 0)
+            reporter_->Warning("Failed to trim event log: %s\n", strerror(errno));
+    }
+    
+    if (fd_ != -1)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+    
+    if (indexFd_ != -1)
+    {
+        close(indexFd_);
+        indexFd_ = -1;
+    }
+}
+
+void EventLog::LogFrame(uint64_t runFrame, uint64_t gameFrame, uint64_t responses)
+{
+    eventlog_frame_t frame;
+    frame.runFrame = runFrame;
+    frame.gameFrame = gameFrame;
+    frame.responses = responses;
+    
+    Append(EventLog_Frame, &frame, sizeof(frame));
+}
+
+void EventLog::LogConsole(const char *text)
+{
+    Append(EventLog_Console, text, strlen(text) + 1);
+}
+
+void EventLog::LogSetValue(const char *variable, const char *value)
+{
+    Append(EventLog_SetValue, variable, strlen(variable) + 1, value, strlen(value) + 1);
+}
+
+void EventLog::LogDataUpdated(const char *data)
+{
+    Append(EventLog_DataUpdated, data, strlen(data) + 1);
+}
+
+void EventLog::Append(EventLogType type, const void *data1, size_t len1, const void *data2,
+                      size_t len2)
+{
+    size_t size = AlignRecord(sizeof(eventlog_record_t) + len1 + len2);
+    
+    if (!segment_ || size > EVENTLOG_SEGMENT_SIZE)
+        return;
+    
+    while (__sync_lock_test_and_set(&lock_, 1))
+        __asm__ __volatile__("pause");
+    
+    // Check again now that no other thread can be moving to the next segment
+    if (!segment_)
+    {
+        __sync_lock_release(&lock_);
+        return;
+    }
+    
+    uint64_t timestamp = ClockNanos() - clockBase_;
+    
+    if (segmentUsed_ + size > EVENTLOG_SEGMENT_SIZE)
+    {
+        // Pad out the rest of this segment, which is always room for at least one record header
+        if (segmentUsed_ < EVENTLOG_SEGMENT_SIZE)
+        {
+            eventlog_record_t *pad = (eventlog_record_t *)&segment_[segmentUsed_];
+            pad->timestamp = timestamp;
+            pad->length = EVENTLOG_SEGMENT_SIZE - segmentUsed_ - sizeof(eventlog_record_t);
+            pad->type = EventLog_Pad;
+        }
+        
+        if (!MapSegment(segmentStart_ + EVENTLOG_SEGMENT_SIZE))
+        {
+            // Give up on the log rather than stopping the server
+            CloseFiles();
+            __sync_lock_release(&lock_);
+            return;
+        }
+    }
+    
+    uint64_t offset = segmentStart_ + segmentUsed_;
+    
+    if (offset >= nextIndex_)
+    {
+        eventlog_index_t entry;
+        entry.timestamp = timestamp;
+        entry.offset = offset;
+        
+        if (write(indexFd_, &entry, sizeof(entry)) == sizeof(entry))
+            nextIndex_ = offset + EVENTLOG_INDEX_INTERVAL;
+    }
+    
+    // New segments are zero-filled, so the padding doesn't need to be cleared
+    eventlog_record_t *record = (eventlog_record_t *)&segment_[segmentUsed_];
+    char *data = (char *)(record + 1);
+    
+    record->timestamp = timestamp;
+    record->length = len1 + len2;
+    memcpy(data, data1, len1);
+    if (len2)
+        memcpy(&data[len1], data2, len2);
+    
+    // Setting the type last means readers never see a half-written record in a live log
+    __asm__ __volatile__("" ::: "memory");
+    record->type = type;
+    
+    segmentUsed_ += size;
+    
+    __sync_lock_release(&lock_);
+}
+
+bool EventLog::MapSegment(uint64_t start)
+{
+    if (segment_)
+    {
+        munmap(segment_, EVENTLOG_SEGMENT_SIZE);
+        segment_ = nullptr;
+    }
+    
+    // Grow the file to cover the new segment
+    if (ftruncate(fd_, start + EVENTLOG_SEGMENT_SIZE) != 0)
+        return false;
+    
+    void *segment = mmap(nullptr, EVENTLOG_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+                         start);
+    if (segment == MAP_FAILED)
+        return false;
+    
+    segment_ = (char *)segment;
+    segmentStart_ = start;
+    segmentUsed_ = 0;
+    
+    return true;
+}
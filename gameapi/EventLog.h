@@ -0,0 +1,78 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_EVENTLOG_H_
+#define _INCLUDE_SRCDS_EVENTLOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "EventLogFormat.h"
+#include "ErrorReporter.h"
+
+// Append-only binary log of server events for post-mortems (see EventLogFormat.h), enabled with
+// -eventlog <file>. The log is written through a memory-mapped segment of the file, so recording
+// an event is a copy into memory. A system call is only needed to move on to the next segment or
+// to add an index entry.
+class EventLog
+{
+public:
+    EventLog(ErrorReporter *reporter);
+    ~EventLog();
+    
+    void ParseOptions(int argc, char *argv[]);
+    bool IsEnabled() const;
+    
+    bool Open();
+    void Close();
+    
+    void LogFrame(uint64_t runFrame, uint64_t gameFrame, uint64_t responses);
+    void LogConsole(const char *text);
+    void LogSetValue(const char *variable, const char *value);
+    void LogDataUpdated(const char *data);
+private:
+    void Append(EventLogType type, const void *data1, size_t len1, const void *data2 = nullptr,
+                size_t len2 = 0);
+    bool MapSegment(uint64_t start);
+    void CloseFiles();
+private:
+    ErrorReporter *reporter_;
+    char path_[1024];
+    int fd_;
+    int indexFd_;
+    
+    char *segment_;
+    uint64_t segmentStart_;     // File offset of the mapped segment
+    size_t segmentUsed_;
+    uint64_t nextIndex_;        // File offset after which the next index entry is due
+    uint64_t clockBase_;
+    
+    // Events can come from the engine thread as well as whichever thread calls SetValue
+    volatile int lock_;
+};
+
+#endif // _INCLUDE_SRCDS_EVENTLOG_H_
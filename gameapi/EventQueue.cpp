@@ -0,0 +1,361 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/time.h>
+#include "EventQueue.h"
+
+// Keeps the compiler from moving memory accesses across this point. That is all the ordering a
+// single producer and consumer need on x86, where stores aren't reordered with other stores and
+// loads aren't reordered with other loads.
+#define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+// How long the delivery thread sleeps before checking for events again if a wakeup was missed
+static const long kWaitNanos = 10000000;
+
+// strnlen isn't available on OS X 10.5
+static size_t BoundedLength(const char *str, size_t maxlen)
+{
+    const char *end = (const char *)memchr(str, '\0', maxlen);
+    return end ? end - str : maxlen;
+}
+
+EventQueue::EventQueue()
+    : listener_(nullptr),
+      console_(nullptr),
+      buffer_(nullptr),
+      head_(0),
+      tail_(0),
+      running_(false),
+      waiting_(false)
+{
+    consoleCursor_.seq = consoleCursor_.msg = 0;
+    pthread_mutex_init(&mutex_, nullptr);
+    pthread_cond_init(&cond_, nullptr);
+}
+
+EventQueue::~EventQueue()
+{
+    Stop();
+    
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+bool EventQueue::Start(IGameListener *listener, const ConsoleRing *console, bool batchConsole)
+{
+    if (running_)
+        return true;
+    
+    if (!buffer_ && (buffer_ = (char *)malloc(kCapacity)) == nullptr)
+        return false;
+    
+    listener_ = listener;
+    console_ = console;
+    consoleCursor_ = console->GetWriteCursor();
+    consoleBatcher_.SetWindow(batchConsole ? CONSOLE_BATCH_FRAME : CONSOLE_BATCH_NONE);
+    head_ = tail_ = 0;
+    running_ = true;
+    
+    if (pthread_create(&thread_, nullptr, ThreadMain, this) != 0)
+    {
+        running_ = false;
+        return false;
+    }
+    
+    return true;
+}
+
+void EventQueue::Stop()
+{
+    if (!running_)
+        return;
+    
+    running_ = false;
+    WakeConsumer();
+    pthread_join(thread_, nullptr);
+    
+    free(buffer_);
+    buffer_ = nullptr;
+}
+
+bool EventQueue::IsRunning() const
+{
+    return running_;
+}
+
+void EventQueue::OnServerLoaded()
+{
+    listener_->OnServerLoaded();
+}
+
+void EventQueue::OnServerStarted()
+{
+    Push(Event_ServerStarted);
+}
+
+void EventQueue::OnServerStopped()
+{
+    Push(Event_ServerStopped);
+}
+
+void EventQueue::OnGameFrame()
+{
+    listener_->OnGameFrame();
+}
+
+void EventQueue::OnValueReceived(const char *variable, const char *value)
+{
+    Push(Event_ValueReceived, variable, value);
+}
+
+void EventQueue::OnDataUpdated(const char *data)
+{
+    Push(Event_DataUpdated, data);
+}
+
+void EventQueue::OnConsoleOutput(const char *msg)
+{
+    // The message is already in the console ring. If this marker doesn't fit, the output gets
+    // delivered with a later marker or once the queue is empty.
+    Push(Event_ConsoleOutput, nullptr, nullptr, false);
+}
+
+void EventQueue::OnWarning(const char *msg)
+{
+    listener_->OnWarning(msg);
+}
+
+void EventQueue::OnError(const char *msg)
+{
+    // Let the delivery thread catch up so the output leading up to the error isn't lost
+    while (running_ && tail_ != head_)
+    {
+        WakeConsumer();
+        sched_yield();
+    }
+    
+    listener_->OnError(msg);
+}
+
+bool EventQueue::Push(EventType type, const char *str1, const char *str2, bool wait)
+{
+    size_t len1 = str1 ? BoundedLength(str1, kMaxString - 1) : 0;
+    size_t len2 = str2 ? BoundedLength(str2, kMaxString - 1) : 0;
+    uint32_t size = (sizeof(EventRecord) + len1 + 1 + len2 + 1 + 7) & ~7;
+    
+    uint32_t head = head_;
+    uint32_t offset = head & (kCapacity - 1);
+    uint32_t pad = (kCapacity - offset < size) ? kCapacity - offset : 0;
+    
+    // If the listener can't keep up, the engine has to wait for it after all
+    while (kCapacity - (head - tail_) < pad + size)
+    {
+        WakeConsumer();
+        
+        if (!wait)
+            return false;
+        
+        sched_yield();
+    }
+    
+    if (pad)
+    {
+        EventRecord *record = (EventRecord *)&buffer_[offset];
+        record->type = Event_Pad;
+        record->size = pad;
+        head += pad;
+        offset = 0;
+    }
+    
+    EventRecord *record = (EventRecord *)&buffer_[offset];
+    char *strings = (char *)(record + 1);
+    
+    record->type = type;
+    record->size = size;
+    record->consoleSeq = console_->GetWriteSeq();
+    
+    memcpy(strings, str1 ? str1 : "", len1);
+    strings[len1] = '\0';
+    memcpy(&strings[len1 + 1], str2 ? str2 : "", len2);
+    strings[len1 + 1 + len2] = '\0';
+    
+    // Publish the record only after it has been written
+    COMPILER_BARRIER();
+    head_ = head + size;
+    
+    if (waiting_)
+        WakeConsumer();
+    
+    return true;
+}
+
+bool EventQueue::DeliverNext()
+{
+    uint32_t tail = tail_;
+    
+    if (tail == head_)
+        return false;
+    
+    COMPILER_BARRIER();
+    
+    const EventRecord *record = (const EventRecord *)&buffer_[tail & (kCapacity - 1)];
+    
+    // Padding only fills the end of the buffer. It has nothing past its header, and can be too
+    // small to even hold a sequence number.
+    if (record->type == Event_Pad)
+    {
+        COMPILER_BARRIER();
+        tail_ = tail + record->size;
+        return true;
+    }
+    
+    const char *str1 = (const char *)(record + 1);
+    const char *str2 = str1 + strlen(str1) + 1;
+    
+    // Console output comes before the event in which it was recorded
+    DeliverConsole(record->consoleSeq);
+    
+    switch (record->type)
+    {
+        case Event_ServerStarted:
+            listener_->OnServerStarted();
+            break;
+        case Event_ServerStopped:
+            listener_->OnServerStopped();
+            break;
+        case Event_ValueReceived:
+            listener_->OnValueReceived(str1, str2);
+            break;
+        case Event_DataUpdated:
+            listener_->OnDataUpdated(str1);
+            break;
+        default:
+            break;
+    }
+    
+    // Hand the space back to the engine thread once the record isn't needed anymore
+    COMPILER_BARRIER();
+    tail_ = tail + record->size;
+    
+    return true;
+}
+
+void EventQueue::DeliverConsole(uint32_t end)
+{
+    // Sequence numbers wrap around, so compare the distance instead
+    while (int32_t(end - consoleCursor_.seq) > 0)
+    {
+        uint32_t dropped;
+        size_t len = console_->Read(&consoleCursor_, consoleText_, sizeof(consoleText_), &dropped);
+        
+        if (dropped > 0)
+        {
+            char marker[64];
+            snprintf(marker, sizeof(marker), "[%u console messages dropped]\n", dropped);
+            DeliverConsoleText(marker);
+        }
+        
+        if (len == 0)
+            break;
+        
+        DeliverConsoleText(consoleText_);
+    }
+    
+    consoleBatcher_.Flush(listener_);
+}
+
+void EventQueue::DeliverConsoleText(const char *text)
+{
+    if (consoleBatcher_.IsEnabled())
+        consoleBatcher_.Append(listener_, text);
+    else
+        listener_->OnConsoleOutput(text);
+}
+
+void EventQueue::WaitForEvents()
+{
+    waiting_ = true;
+    __sync_synchronize();
+    
+    // The engine thread doesn't take the mutex when it signals, so a wakeup can be missed. The
+    // timeout makes sure that only delays delivery a little.
+    if (running_ && tail_ == head_)
+    {
+        struct timeval now;
+        struct timespec timeout;
+        
+        gettimeofday(&now, nullptr);
+        timeout.tv_sec = now.tv_sec;
+        timeout.tv_nsec = now.tv_usec * 1000 + kWaitNanos;
+        
+        if (timeout.tv_nsec >= 1000000000)
+        {
+            timeout.tv_sec++;
+            timeout.tv_nsec -= 1000000000;
+        }
+        
+        pthread_mutex_lock(&mutex_);
+        pthread_cond_timedwait(&cond_, &mutex_, &timeout);
+        pthread_mutex_unlock(&mutex_);
+    }
+    
+    waiting_ = false;
+}
+
+void EventQueue::WakeConsumer()
+{
+    pthread_cond_signal(&cond_);
+}
+
+void *EventQueue::ThreadMain(void *param)
+{
+    EventQueue *queue = (EventQueue *)param;
+    
+    while (true)
+    {
+        // Check this first so that events pushed before Stop() are still delivered
+        bool stopping = !queue->running_;
+        
+        if (!queue->DeliverNext())
+        {
+            // Pick up console output whose marker didn't fit into the queue
+            queue->DeliverConsole(queue->console_->GetWriteSeq());
+            
+            if (stopping)
+                break;
+            
+            queue->WaitForEvents();
+        }
+    }
+    
+    return nullptr;
+}
@@ -0,0 +1,129 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_EVENTQUEUE_H_
+#define _INCLUDE_SRCDS_EVENTQUEUE_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include "IGameAPI.h"
+#include "ConsoleRing.h"
+#include "ConsoleBatcher.h"
+
+// Listener proxy that moves event delivery off the engine thread. The engine thread copies each
+// event into a single-producer/single-consumer ring buffer and a separate thread passes it on to
+// the real listener in the same order.
+//
+// OnServerLoaded, OnGameFrame and OnError are still called synchronously: OnServerLoaded adds
+// command line parameters before the engine reads them, OnGameFrame pumps GUI events on the main
+// thread and OnError happens right before the process exits. OnError waits for the queue to drain
+// first so no output is lost.
+//
+// Console output isn't copied into the queue. The engine thread has already written it to the
+// console ring, so the queue only records how far to read the ring at that point. If the listener
+// falls behind the ring, it gets a message saying how much output was dropped instead of the
+// engine waiting for it.
+class EventQueue : public IGameListener
+{
+public:
+    EventQueue();
+    ~EventQueue();
+    
+    // Starts the delivery thread. With batchConsole, console output that is waiting in the ring
+    // is delivered as one batch.
+    bool Start(IGameListener *listener, const ConsoleRing *console, bool batchConsole);
+    
+    // Delivers the remaining events and stops the delivery thread
+    void Stop();
+    
+    bool IsRunning() const;
+public:
+    // IGameListener, only to be called from the engine thread
+    void OnServerLoaded();
+    void OnServerStarted();
+    void OnServerStopped();
+    void OnGameFrame();
+    void OnValueReceived(const char *variable, const char *value);
+    void OnDataUpdated(const char *data);
+    void OnConsoleOutput(const char *msg);
+    void OnWarning(const char *msg);
+    void OnError(const char *msg);
+private:
+    enum EventType
+    {
+        Event_Pad,              // Fills the end of the buffer when a record doesn't fit there
+        Event_ServerStarted,
+        Event_ServerStopped,
+        Event_ValueReceived,
+        Event_DataUpdated,
+        Event_ConsoleOutput
+    };
+    
+    // Records are followed by up to two NUL-terminated strings
+    struct EventRecord
+    {
+        uint32_t type;
+        uint32_t size;          // Including this header, a multiple of 8
+        uint32_t consoleSeq;    // Console ring sequence number to deliver output up to
+    };
+    
+    bool Push(EventType type, const char *str1 = nullptr, const char *str2 = nullptr,
+              bool wait = true);
+    bool DeliverNext();
+    void DeliverConsole(uint32_t end);
+    void DeliverConsoleText(const char *text);
+    void WaitForEvents();
+    void WakeConsumer();
+    
+    static void *ThreadMain(void *param);
+private:
+    static const uint32_t kCapacity = 1 << 20;
+    static const uint32_t kMaxString = 32768;
+    
+    IGameListener *listener_;
+    const ConsoleRing *console_;
+    char *buffer_;
+    
+    // Total bytes written and read. Only the engine thread writes head_ and only the delivery
+    // thread writes tail_.
+    volatile uint32_t head_;
+    volatile uint32_t tail_;
+    
+    volatile bool running_;
+    volatile bool waiting_;
+    pthread_t thread_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t cond_;
+    
+    // Only used by the delivery thread
+    console_cursor_t consoleCursor_;
+    char consoleText_[ConsoleRing::kSlotText + 1];
+    ConsoleBatcher consoleBatcher_;
+};
+
+#endif // _INCLUDE_SRCDS_EVENTQUEUE_H_
@@ -0,0 +1,88 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include "FramePacer.h"
+#include "Clock.h"
+
+// How long before a tick to stop sleeping and start spinning. This needs to cover the scheduler's
+// wakeup latency.
+static const uint64_t kSpinNanos = 200000;
+
+FramePacer::FramePacer()
+    : interval_(0),
+      nextTick_(0),
+      lastTick_(0)
+{
+
+}
+
+void FramePacer::SetTickRate(double tickRate)
+{
+    interval_ = (tickRate > 0.0) ? uint64_t(1000000000.0 / tickRate) : 0;
+    nextTick_ = 0;
+    lastTick_ = 0;
+}
+
+bool FramePacer::IsEnabled() const
+{
+    return interval_ != 0;
+}
+
+void FramePacer::WaitForNextTick()
+{
+    uint64_t now = ClockNanos();
+    
+    if (nextTick_ == 0 || now > nextTick_ + interval_)
+    {
+        // First tick, or the server fell more than a tick behind. Start over from now rather than
+        // running a burst of frames to catch up.
+        nextTick_ = now;
+    }
+    else
+    {
+        if (nextTick_ > now + kSpinNanos)
+            ClockSleepUntil(nextTick_ - kSpinNanos);
+        
+        while ((now = ClockNanos()) < nextTick_)
+            __asm__ __volatile__("pause");
+    }
+    
+    if (lastTick_)
+    {
+        uint64_t elapsed = now - lastTick_;
+        jitter_.Record(elapsed > interval_ ? elapsed - interval_ : interval_ - elapsed);
+    }
+    
+    lastTick_ = now;
+    nextTick_ += interval_;
+}
+
+void FramePacer::GetJitter(hdr_stats_t *stats) const
+{
+    jitter_.Snapshot(stats);
+}
@@ -0,0 +1,59 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_FRAMEPACER_H_
+#define _INCLUDE_SRCDS_FRAMEPACER_H_
+
+#include <stdint.h>
+#include "HdrHistogram.h"
+
+// Starts server frames on a fixed tick interval. Sleeps until shortly before the next tick is due
+// and spins for the rest. This doesn't replace the engine's millisecond sleep inside the frame, it
+// only keeps frame starts from drifting with it.
+class FramePacer
+{
+public:
+    FramePacer();
+    
+    // Sets the number of ticks per second. Pacing is disabled if this is 0.
+    void SetTickRate(double tickRate);
+    bool IsEnabled() const;
+    
+    // Waits until the next tick is due and records how far off the previous interval was
+    void WaitForNextTick();
+    
+    // Snapshots the difference between achieved and target tick intervals (in nanoseconds)
+    void GetJitter(hdr_stats_t *stats) const;
+private:
+    uint64_t interval_;
+    uint64_t nextTick_;
+    uint64_t lastTick_;
+    HdrHistogram jitter_;
+};
+
+#endif // _INCLUDE_SRCDS_FRAMEPACER_H_
@@ -27,21 +27,33 @@
  */
 
 #include <stdio.h>
-#include "stringutil.h"
+#include <string.h>
 
 #include "GameAPI.h"
 #include "GameLib.h"
 #include "ICommandLine.h"
 #include "IGameServerData.h"
 #include "ByteBuffer.h"
+#include "DetourStats.h"
+#include "StartupTrace.h"
+#include "DirScan.h"
+#include "KeyValuesFile.h"
 #include "platform.h"
 
 GameAPI::GameAPI()
     : uimode_(UIMode_GUI),
+      eventMask_(GameEvent_All),
+      asyncEvents_(false),
       detector_(&reporter_),
+      prefetcher_(&reporter_),
+      tuning_(&reporter_),
+      profiler_(&reporter_),
+      logSink_(&reporter_),
+      eventLog_(&reporter_),
       serverFix_(&reporter_),
       dataListener_(INVALID_LISTENER_ID),
       currentDataRequest_(0),
+      pendingValues_(0),
       GameCmdLine_(nullptr),
       Plat_FloatTime_(nullptr)
 {
@@ -66,37 +78,36 @@ void GameAPI::AddParam(const char *param, const char *value)
 
 void GameAPI::BuildGameList(LinkedList<game_t> &gameList)
 {
-    game_t game;
-    FileFindHandle_t handle;
-    
-    // Load filesystem library and add current directory to search path if necessary
-    if (!fileSystem_.IsInitialized())
-    {
-        fileSystem_.Initialize();
-        fileSystem_.AddSearchPath(".", "MAIN", PATH_ADD_TO_HEAD);
-    }
+    // Only directories that changed since the last listing are looked at again
+    gameIndex_.BuildGameList(gameList, GetGameDescription);
+}
 
-    const char *file = fileSystem_.FindFirst("*.*", &handle);
+void GameAPI::BuildMapListForGame(const char *gameDir, LinkedList<AString> &mapList)
+{
+    AString mapsDir(gameDir);
+    DirReader reader;
     
-    while (file)
+    mapsDir.append(PLATFORM_SEP "maps");
+    
+    // The maps directory can usually be listed directly, which avoids a call into the engine
+    // filesystem for every file
+    if (reader.Open(mapsDir.chars()))
     {
-        // Find all valid game directories and add them to the list
-        if (file[0] != '.' && fileSystem_.FindIsDirectory(handle) && IsValidGameDirectory(file))
+        const char *file;
+        unsigned char type;
+        
+        while ((file = reader.Next(&type)) != nullptr)
         {
-            game_t game;
-            game.gameDirectory = file;
-            game.gameDescription = GetGameDescription(file);
-            gameList.append(game);
+            size_t length = strlen(file);
             
+            // Store map file name without .bsp (4 characters)
+            if (length > 4 && strcasecmp(file + length - 4, ".bsp") == 0)
+                mapList.append(AString(file, length - 4));
         }
-        file = fileSystem_.FindNext(handle);
+        
+        return;
     }
     
-    fileSystem_.FindClose(handle);
-}
-
-void GameAPI::BuildMapListForGame(const char *gameDir, LinkedList<AString> &mapList)
-{
     FileFindHandle_t handle;
     AString wildcard(gameDir);
     
@@ -125,89 +136,26 @@ void GameAPI::BuildMapListForGame(const char *gameDir, LinkedList<AString> &mapL
     fileSystem_.FindClose(handle);
 }
 
-bool GameAPI::IsValidGameDirectory(const char *gamedir)
-{
-    FileFindHandle_t handle;
-    AString wildcard(gamedir);
-    
-    wildcard.append(PLATFORM_SEP "*.*");
-    
-    const char *file = fileSystem_.FindFirst(wildcard.chars(), &handle);
-    
-    bool isValid = false;
-    bool hasBinaries = false;
-    bool hasGameInfo = false;
-    
-    // A valid game directory contains a 'bin' directory and a file named 'gameinfo.txt'
-    while (file)
-    {
-        if (strcasecmp(file, "bin") == 0)
-        {
-            if (fileSystem_.FindIsDirectory(handle))
-                hasBinaries = true;
-            else
-                break;
-        }
-        else if (strcasecmp(file, "gameinfo.txt") == 0)
-        {
-            if (!fileSystem_.FindIsDirectory(handle))
-                hasGameInfo = true;
-            else
-                break;
-        }
-        
-        if (hasBinaries && hasGameInfo)
-        {
-            isValid = true;
-            break;
-        }
-        
-        file = fileSystem_.FindNext(handle);
-    }
-    
-    fileSystem_.FindClose(handle);
-    
-    return isValid;
-}
-
 // Returns the user-friendly game name from the gameinfo.txt file in the specifed game directory
 AString GameAPI::GetGameDescription(const char *gamedir)
 {
     AString gameinfo(gamedir);
+    KeyValuesFile kv;
     
-    gameinfo.append("/gameinfo.txt");
+    gameinfo.append(PLATFORM_SEP "gameinfo.txt");
     
-    FILE *fp = fopen(gameinfo.chars(), "rt");
-    
-    if (!fp)
+    if (!kv.Open(gameinfo.chars()))
         return AString();
     
-    char buffer[256], key[128], value[128];
-    int level = 0;
-    
-    // TODO: Need a real parser to handle edge cases
-    while (!feof(fp) && fgets(buffer, sizeof(buffer), fp) != nullptr)
+    // The game name is within the first set of curly braces
+    for (const kv_node_t *block = kv.GetFirstChild(nullptr); block; block = kv.GetNextSibling(block))
     {
-        char *pBuf = buffer;
-        pBuf = strip_comments(pBuf);
-        pBuf = strtrim(pBuf);
+        const kv_node_t *game = kv.FindChild(block, "game");
         
-        if (*pBuf == '{')
-            level++;
-        else if (*pBuf == '}' && level > 0)
-            level--;
-        else
-        {
-            splitkv(pBuf, key, sizeof(key), value, sizeof(value));
-        
-            // The game name is within the first set of curly braces
-            if (level == 1 && strcasecmp(key, "game") == 0)
-                return AString(value);
-        }
+        if (game && game->value)
+            return KeyValuesFile::GetValue(game);
     }
     
-    fclose(fp);
-    
     return AString();
 }
 
@@ -218,9 +166,24 @@ void GameAPI::RunServer(UIMode mode, int argc, char *argv[])
     
     uimode_ = mode;
     
+    // Start the startup timeline before anything is loaded
+    StartupTrace::ParseOptions(argc, argv);
+    
     // Initialize the game/engine detector
     detector_.Initialize(argc, argv);
     
+    // The engine runs its frames on this thread
+    tuning_.ParseOptions(argc, argv);
+    tuning_.ApplyToCurrentThread();
+    profiler_.ParseOptions(argc, argv);
+    profiler_.Start();
+    
+    // Start writing the console log before any output is produced
+    logSink_.ParseOptions(argc, argv);
+    logSink_.Start();
+    eventLog_.ParseOptions(argc, argv);
+    eventLog_.Open();
+    
     const AString& game = detector_.GetGameName();
     if (game.chars() == NULL || game.compare("") == 0)
     {
@@ -228,6 +191,10 @@ void GameAPI::RunServer(UIMode mode, int argc, char *argv[])
         return;
     }
     
+    // Read the rest of the libraries ahead of the engine loading them one by one
+    prefetcher_.ParseOptions(argc, argv);
+    prefetcher_.Start(game.chars());
+    
     if (detector_.GetEngineBranch() == Engine_Unknown)
     {
         reporter_.Error("Unknown game engine detected.\n");
@@ -240,7 +207,10 @@ void GameAPI::RunServer(UIMode mode, int argc, char *argv[])
         return;
     }
 
-    serverFix_.Initialize(&detector_.GetGameName(), detector_.GetEngineBranch());
+    {
+        TRACE_SCOPE("ServerFix::Initialize", nullptr);
+        serverFix_.Initialize(&detector_.GetGameName(), detector_.GetEngineBranch());
+    }
     
     DedicatedMain = dedicated_.ResolveSymbol<DedicateMainFn>("DedicatedMain");
     if (!DedicatedMain)
@@ -258,9 +228,24 @@ void GameAPI::RunServer(UIMode mode, int argc, char *argv[])
     dataListener_ = serverData_->GetNextListenerID(false);
     serverData_->RegisterAdminUIID(dataListener_);
     
+    // Listener events go through the queue from here on
+    if (asyncEvents_ && !eventQueue_.Start(listener_, &console_, consoleBatcher_.IsEnabled()))
+        reporter_.Warning("Failed to start event delivery thread. Delivering events on the engine "
+                          "thread instead.\n");
+    
     // Run the dedicated server entry point function
     DedicatedMain(argc, argv);
     
+    // In case the server never got to its first frame
+    StartupTrace::Finish();
+    
+    consoleBatcher_.Flush(GetGameListener());
+    serverFix_.NotifyServerStopped();
+    profiler_.Stop();
+    eventQueue_.Stop();
+    logSink_.Stop();
+    eventLog_.Close();
+    prefetcher_.Stop();
     serverFix_.Shutdown();
 }
 
@@ -283,6 +268,9 @@ void GameAPI::ExecCommand(const char *cmd)
     buf.WriteByte('\0');
     
     serverData_->WriteDataRequest(dataListener_, buf.GetBase(), buf.GetBytesWritten());
+    
+    // Make sure the responses (or the last frame in case of "quit") get processed
+    serverFix_.RequestFrames();
 }
 
 void GameAPI::SetValue(const char *variable, const char *value)
@@ -295,6 +283,9 @@ void GameAPI::SetValue(const char *variable, const char *value)
     buf.WriteString(value);
     
     serverData_->WriteDataRequest(dataListener_, buf.GetBase(), buf.GetBytesWritten());
+    serverFix_.RequestFrames();
+    
+    eventLog_.LogSetValue(variable, value);
 }
 
 void GameAPI::RequestValue(const char *variable)
@@ -306,7 +297,16 @@ void GameAPI::RequestValue(const char *variable)
     buf.WriteString(variable);
     buf.WriteByte('\0');
     
+    // Frames stay detoured until the value arrives, however long that takes
+    __sync_add_and_fetch(&pendingValues_, 1);
+    
     serverData_->WriteDataRequest(dataListener_, buf.GetBase(), buf.GetBytesWritten());
+    serverFix_.RequestFrames();
+}
+
+bool GameAPI::HasPendingValues()
+{
+    return pendingValues_ > 0;
 }
 
 float GameAPI::GetFrameTime()
@@ -314,6 +314,14 @@ float GameAPI::GetFrameTime()
     return Plat_FloatTime_();
 }
 
+void GameAPI::SetEventMask(int events)
+{
+    eventMask_ = events;
+    
+    // Arm or disarm the detours that deliver these events if the server is already running
+    serverFix_.UpdateEventDetours();
+}
+
 // Load tier0 library and get pointers to functions used by the API
 void GameAPI::LoadTier0()
 {
@@ -377,13 +385,17 @@ void GameAPI::ProcessServerResponses()
                     else
                         valueBuf.WriteByte('\0');
                     
-                    listener_->OnValueReceived(variable, valueBuf.GetBase());
+                    GetGameListener()->OnValueReceived(variable, valueBuf.GetBase());
+                    
+                    if (pendingValues_ > 0)
+                        __sync_sub_and_fetch(&pendingValues_, 1);
                 }
                 break;
             
             // Notify the listener that some kind of server data has been updated
             case SERVERDATA_UPDATE:
-                listener_->OnDataUpdated(variable);
+                eventLog_.LogDataUpdated(variable);
+                GetGameListener()->OnDataUpdated(variable);
                 
             default:
                 assert(responseType == SERVERDATA_RESPONSE_VALUE ||
@@ -398,11 +410,155 @@ UIMode GameAPI::GetUIMode()
     return uimode_;
 }
 
+size_t GameAPI::GetDetourStats(detour_stats_t *stats, size_t maxStats)
+{
+    return DetourStats::GetAll(stats, maxStats);
+}
+
+void GameAPI::GetFrameStats(frame_stats_t *stats)
+{
+    serverFix_.GetFrameStats(stats);
+}
+
+void GameAPI::GetSchedStats(sched_stats_t *stats)
+{
+    tuning_.GetStats(stats);
+}
+
+void GameAPI::SetAsyncEvents(bool enable)
+{
+    asyncEvents_ = enable;
+}
+
+size_t GameAPI::ReadConsoleOutput(console_cursor_t *cursor, char *buffer, size_t maxlength, uint32_t *dropped)
+{
+    return console_.Read(cursor, buffer, maxlength, dropped);
+}
+
+void GameAPI::GetLogStats(log_stats_t *stats)
+{
+    memset(stats, 0, sizeof(log_stats_t));
+    
+    if (logSink_.IsEnabled())
+        logSink_.GetStats(stats);
+}
+
+bool GameAPI::WriteProfile(const char *path)
+{
+    if (!profiler_.IsRunning())
+        return false;
+    
+    return profiler_.Write(path);
+}
+
+void GameAPI::BuildMapCatalogForGame(const char *gameDir, LinkedList<map_info_t> &mapList)
+{
+    mapCatalog_.BuildCatalog(gameDir, mapList);
+}
+
+void GameAPI::BuildSearchPathsForGame(const char *gameDir, LinkedList<search_path_t> &pathList)
+{
+    AString gameinfo(gameDir);
+    KeyValuesFile kv;
+    
+    gameinfo.append(PLATFORM_SEP "gameinfo.txt");
+    
+    if (!kv.Open(gameinfo.chars()))
+        return;
+    
+    // GameInfo { FileSystem { SearchPaths { <path IDs> <path> ... } } }
+    const kv_node_t *node = kv.FindChild(nullptr, "GameInfo");
+    
+    if (node)
+        node = kv.FindChild(node, "FileSystem");
+    
+    if (node)
+        node = kv.FindChild(node, "SearchPaths");
+    
+    if (!node)
+        return;
+    
+    for (node = kv.GetFirstChild(node); node; node = kv.GetNextSibling(node))
+    {
+        if (!node->value)
+            continue;
+        
+        search_path_t searchPath;
+        searchPath.pathIds = KeyValuesFile::GetKey(node);
+        searchPath.path = KeyValuesFile::GetValue(node);
+        pathList.append(searchPath);
+    }
+}
+
+void GameAPI::SetConsoleBatchWindow(unsigned int micros)
+{
+    // Don't hold on to output that was gathered with the old window
+    if (!eventQueue_.IsRunning())
+        consoleBatcher_.Flush(listener_);
+    
+    consoleBatcher_.SetWindow(micros);
+    
+    // Batches are delivered at the end of frames
+    serverFix_.UpdateEventDetours();
+}
+
+void GameAPI::FlushConsoleOutput()
+{
+    ConsoleBatcher *batcher = GetConsoleBatcher();
+    
+    if (batcher)
+        batcher->FlushIfDue(listener_, false);
+}
+
+ICommandLine *GameAPI::GetCommandLine()
+{
+    return GameCmdLine_();
+}
+
+int GameAPI::GetEventMask()
+{
+    return eventMask_;
+}
+
 GameDetector &GameAPI::GetGameDetector()
 {
     return detector_;
 }
 
+ThreadTuning &GameAPI::GetThreadTuning()
+{
+    return tuning_;
+}
+
+SamplingProfiler &GameAPI::GetProfiler()
+{
+    return profiler_;
+}
+
+ConsoleRing &GameAPI::GetConsoleRing()
+{
+    return console_;
+}
+
+LogSink &GameAPI::GetLogSink()
+{
+    return logSink_;
+}
+
+EventLog &GameAPI::GetEventLog()
+{
+    return eventLog_;
+}
+
+ConsoleBatcher *GameAPI::GetConsoleBatcher()
+{
+    // The delivery thread batches asynchronous events itself
+    if (eventQueue_.IsRunning() || !consoleBatcher_.IsEnabled())
+        return nullptr;
+    
+    return &consoleBatcher_;
+}
+
 ErrorReporter &GameAPI::GetErrorReporter()
 {
     return reporter_;
@@ -410,7 +566,7 @@ ErrorReporter &GameAPI::GetErrorReporter()
 
 IGameListener *GameAPI::GetGameListener()
 {
-    return listener_;
+    return eventQueue_.IsRunning() ? &eventQueue_ : listener_;
 }
 
 IGameAPI *GetGameAPI()
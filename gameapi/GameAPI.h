@@ -32,8 +32,17 @@
 #include "IGameAPI.h"
 #include "GameLib.h"
 #include "GameDetector.h"
+#include "ThreadTuning.h"
+#include "LibraryPrefetch.h"
+#include "EventQueue.h"
+#include "ConsoleBatcher.h"
+#include "LogSink.h"
+#include "EventLog.h"
 #include "ServerFix.h"
+#include "SamplingProfiler.h"
 #include "FileSystem.h"
+#include "GameIndex.h"
+#include "MapCatalog.h"
 #include "ICommandLine.h"
 #include "IGameServerData.h"
 
@@ -57,6 +66,18 @@ public:
     void SetValue(const char *variable, const char *value);
     void RequestValue(const char *variable);
     float GetFrameTime();
+    void SetEventMask(int events);
+    size_t GetDetourStats(detour_stats_t *stats, size_t maxStats);
+    void GetFrameStats(frame_stats_t *stats);
+    void GetSchedStats(sched_stats_t *stats);
+    void SetAsyncEvents(bool enable);
+    size_t ReadConsoleOutput(console_cursor_t *cursor, char *buffer, size_t maxlength, uint32_t *dropped);
+    void SetConsoleBatchWindow(unsigned int micros);
+    void GetLogStats(log_stats_t *stats);
+    bool WriteProfile(const char *path);
+    void BuildMapCatalogForGame(const char *gameDir, LinkedList<map_info_t> &mapList);
+    void BuildSearchPathsForGame(const char *gameDir, LinkedList<search_path_t> &pathList);
+    void FlushConsoleOutput();
 public:
     static inline GameAPI &GetInstance()
     {
@@ -64,27 +85,48 @@ public:
         return api;
     }
     UIMode GetUIMode();
+    int GetEventMask();
+    ICommandLine *GetCommandLine();
     IGameListener *GetGameListener();
     GameDetector &GetGameDetector();
     ErrorReporter &GetErrorReporter();
+    ThreadTuning &GetThreadTuning();
+    SamplingProfiler &GetProfiler();
+    ConsoleRing &GetConsoleRing();
+    ConsoleBatcher *GetConsoleBatcher();
+    LogSink &GetLogSink();
+    EventLog &GetEventLog();
     void LoadTier0();
     void ProcessServerResponses();
+    bool HasPendingValues();
 private:
-    bool IsValidGameDirectory(const char *gamedir);
-    AString GetGameDescription(const char *gamedir);
+    static AString GetGameDescription(const char *gamedir);
 private:
     UIMode uimode_;
+    int eventMask_;
     IGameListener *listener_;
+    EventQueue eventQueue_;
+    ConsoleRing console_;
+    ConsoleBatcher consoleBatcher_;
+    bool asyncEvents_;
     ErrorReporter reporter_;
     GameDetector detector_;
+    LibraryPrefetcher prefetcher_;
+    ThreadTuning tuning_;
+    SamplingProfiler profiler_;
+    LogSink logSink_;
+    EventLog eventLog_;
     ServerFix serverFix_;
     GameFileSystem fileSystem_;
+    GameIndex gameIndex_;
+    MapCatalog mapCatalog_;
     GameLib tier0_;
     GameLib dedicated_;
 
     IGameServerData *serverData_;
     ra_listener_id dataListener_;
     int currentDataRequest_;
+    volatile int pendingValues_;    // RequestValue calls that haven't been answered yet
 private:
     typedef ICommandLine *(*CmdLineFn)(void);
     typedef float (*TimeFn)(void);
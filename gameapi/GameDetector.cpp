@@ -26,8 +26,30 @@
  * this exception to all derivative works.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
 #include "GameDetector.h"
 #include "GameLib.h"
+#include "CacheDir.h"
+
+#if defined(PLATFORM_MACOSX)
+#include <mach-o/loader.h>
+#include <mach-o/fat.h>
+#define LIBEXT ".dylib"
+#define LIBPATH_ENV "DYLD_LIBRARY_PATH"
+#else
+#define LIBEXT ".so"
+#define LIBPATH_ENV "LD_LIBRARY_PATH"
+#endif
+
+// Engine branches detected before, one "<game> <library builds> <branch>" line per game
+#define ENGINE_CACHE_FILE SRCDS_CACHE_DIR "/engine_cache"
 
 static const char *engineStrings[] =
 {
@@ -104,7 +126,318 @@ void GameDetector::DetectGameName(int argc, char *argv[])
     }
 }
 
+// Finds the file that GameLib::Load would load for a library without loading it. The candidate
+// names are tried in the same order as GameLib tries them, each in the places dlopen() searches
+// for a plain name. A library that is already loaded is taken from where it was loaded from.
+static bool FindLibraryFile(const char *name, AString *path)
+{
+    AString names[4];
+    size_t nameCount = 0;
+    
+#if defined(PLATFORM_LINUX)
+    names[nameCount] = name;
+    names[nameCount++].append("_srv" LIBEXT);
+#endif
+    names[nameCount] = name;
+    names[nameCount++].append(LIBEXT);
+#if defined(PLATFORM_LINUX)
+    names[nameCount] = "lib";
+    names[nameCount].append(name);
+    names[nameCount++].append("_srv" LIBEXT);
+#endif
+    names[nameCount] = "lib";
+    names[nameCount].append(name);
+    names[nameCount++].append(LIBEXT);
+    
+    for (size_t i = 0; i < nameCount; i++)
+    {
+        void *handle = dlopen(names[i].chars(), RTLD_LAZY | RTLD_NOLOAD);
+        
+        if (!handle)
+            continue;
+        
+        Dl_info info;
+        void *factory = dlsym(handle, "CreateInterface");
+        bool found = factory && dladdr(factory, &info) && info.dli_fname;
+        
+        if (found)
+            *path = info.dli_fname;
+        
+        dlclose(handle);
+        
+        if (found)
+            return true;
+    }
+    
+    // dlopen() searches the library path first. OS X then tries the working directory; its other
+    // fallbacks (and the system directories on Linux) never have game libraries.
+    AString dirs[16];
+    size_t dirCount = 0;
+    
+    const char *env = getenv(LIBPATH_ENV);
+    
+    while (env && *env && dirCount < sizeof(dirs) / sizeof(dirs[0]) - 1)
+    {
+        const char *end = strchr(env, ':');
+        size_t len = end ? size_t(end - env) : strlen(env);
+        
+        if (len)
+            dirs[dirCount++] = AString(env, len);
+        
+        env = end ? end + 1 : nullptr;
+    }
+    
+#if defined(PLATFORM_MACOSX)
+    dirs[dirCount++] = ".";
+#endif
+    
+    for (size_t i = 0; i < nameCount; i++)
+    {
+        for (size_t j = 0; j < dirCount; j++)
+        {
+            struct stat st;
+            
+            *path = dirs[j];
+            path->append("/");
+            path->append(names[i]);
+            
+            if (stat(path->chars(), &st) == 0 && S_ISREG(st.st_mode))
+                return true;
+        }
+    }
+    
+    return false;
+}
+
+#if defined(PLATFORM_MACOSX)
+// Reads the UUID that the linker gives each build of a Mach-O library as a hex string. Only the
+// headers are read, and for a universal binary only the slice this process would load.
+static bool ReadLibraryUUID(int fd, char *buffer, size_t maxlength)
+{
+#if defined(__x86_64__)
+    const uint32_t cpuType = CPU_TYPE_X86_64;
+    const uint32_t machMagic = MH_MAGIC_64;
+    const size_t headerSize = sizeof(struct mach_header_64);
+#else
+    const uint32_t cpuType = CPU_TYPE_I386;
+    const uint32_t machMagic = MH_MAGIC;
+    const size_t headerSize = sizeof(struct mach_header);
+#endif
+    struct mach_header header;
+    off_t offset = 0;
+    
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header))
+        return false;
+    
+    // Fat headers are always big endian
+    if (header.magic == FAT_CIGAM || header.magic == FAT_MAGIC)
+    {
+        struct fat_header fat;
+        
+        if (pread(fd, &fat, sizeof(fat), 0) != sizeof(fat))
+            return false;
+        
+        uint32_t count = ntohl(fat.nfat_arch);
+        
+        for (uint32_t i = 0; i < count && !offset; i++)
+        {
+            struct fat_arch arch;
+            
+            if (pread(fd, &arch, sizeof(arch), sizeof(fat) + i * sizeof(arch)) != sizeof(arch))
+                return false;
+            
+            if (ntohl(arch.cputype) == cpuType)
+                offset = ntohl(arch.offset);
+        }
+        
+        if (!offset || pread(fd, &header, sizeof(header), offset) != sizeof(header))
+            return false;
+    }
+    
+    if (header.magic != machMagic || header.sizeofcmds > 1024 * 1024)
+        return false;
+    
+    char *cmds = (char *)malloc(header.sizeofcmds);
+    bool found = false;
+    
+    if (cmds && pread(fd, cmds, header.sizeofcmds, offset + headerSize) == header.sizeofcmds)
+    {
+        const char *cmd = cmds;
+        const char *end = cmds + header.sizeofcmds;
+        
+        for (uint32_t i = 0; i < header.ncmds && cmd + sizeof(load_command) <= end; i++)
+        {
+            const struct load_command *lc = (const struct load_command *)cmd;
+            
+            if (lc->cmdsize < sizeof(load_command) || cmd + lc->cmdsize > end)
+                break;
+            
+            if (lc->cmd == LC_UUID && lc->cmdsize >= sizeof(uuid_command))
+            {
+                const struct uuid_command *uuid = (const struct uuid_command *)lc;
+                
+                for (size_t b = 0; b < sizeof(uuid->uuid) && b * 2 + 2 < maxlength; b++)
+                    snprintf(&buffer[b * 2], 3, "%02x", uuid->uuid[b]);
+                
+                found = true;
+                break;
+            }
+            
+            cmd += lc->cmdsize;
+        }
+    }
+    
+    free(cmds);
+    
+    return found;
+}
+#endif
+
+// Builds a string that changes with every build of a library. This is the Mach-O UUID if there is
+// one, otherwise the size and modification time of the file.
+static bool GetLibraryBuildId(const char *name, char *buffer, size_t maxlength)
+{
+    AString path;
+    
+    if (!FindLibraryFile(name, &path))
+        return false;
+    
+    int fd = open(path.chars(), O_RDONLY);
+    
+    if (fd == -1)
+        return false;
+    
+    bool found = false;
+    
+#if defined(PLATFORM_MACOSX)
+    found = ReadLibraryUUID(fd, buffer, maxlength);
+#endif
+    
+    struct stat st;
+    
+    if (!found && fstat(fd, &st) == 0)
+    {
+        snprintf(buffer, maxlength, "%llx-%llx", (unsigned long long)st.st_size,
+                 (unsigned long long)st.st_mtime);
+        found = true;
+    }
+    
+    close(fd);
+    
+    return found;
+}
+
+// Builds a string that changes whenever one of the libraries ProbeGameEngine looks at changes
+static bool GetEngineBuildId(char *buffer, size_t maxlength)
+{
+    char engine[64], vstdlib[64], datacache[64];
+    
+    if (!GetLibraryBuildId("engine", engine, sizeof(engine)) ||
+        !GetLibraryBuildId("vstdlib", vstdlib, sizeof(vstdlib)))
+    {
+        return false;
+    }
+    
+    // Not every branch has a datacache library
+    if (!GetLibraryBuildId("datacache", datacache, sizeof(datacache)))
+        strcpy(datacache, "none");
+    
+    size_t len = snprintf(buffer, maxlength, "%s/%s/%s", engine, vstdlib, datacache);
+    
+    return len < maxlength;
+}
+
+bool GameDetector::LoadCachedEngine(const char *buildId)
+{
+    FILE *fp = fopen(ENGINE_CACHE_FILE, "r");
+    
+    if (!fp)
+        return false;
+    
+    char line[640];
+    char game[256], build[256], branch[32];
+    
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "%255s %255s %31s", game, build, branch) != 3 ||
+            gameName_.compare(game) != 0 || strcmp(build, buildId) != 0)
+        {
+            continue;
+        }
+        
+        for (size_t i = 0; i < sizeof(engineStrings) / sizeof(engineStrings[0]); i++)
+        {
+            if (strcmp(branch, engineStrings[i]) == 0)
+            {
+                gameEngine_ = EngineBranch(i);
+                fclose(fp);
+                return true;
+            }
+        }
+    }
+    
+    fclose(fp);
+    
+    return false;
+}
+
+void GameDetector::SaveCachedEngine(const char *buildId)
+{
+    // Keep the entries for other games, and replace the one for this game
+    AString contents;
+    FILE *fp = fopen(ENGINE_CACHE_FILE, "r");
+    
+    if (fp)
+    {
+        char line[640];
+        char game[256];
+        
+        while (fgets(line, sizeof(line), fp))
+        {
+            if (sscanf(line, "%255s", game) == 1 && gameName_.compare(game) != 0)
+                contents.append(line);
+        }
+        
+        fclose(fp);
+    }
+    
+    if (!MakeCacheDir())
+        return;
+    
+    char tempPath[64];
+    snprintf(tempPath, sizeof(tempPath), ENGINE_CACHE_FILE ".%d", (int)getpid());
+    
+    fp = fopen(tempPath, "w");
+    
+    if (!fp)
+        return;
+    
+    fputs(contents.chars(), fp);
+    fprintf(fp, "%s %s %s\n", gameName_.chars(), buildId, GetEngineString());
+    
+    // Readers only ever see a complete file
+    if (fclose(fp) != 0 || rename(tempPath, ENGINE_CACHE_FILE) != 0)
+        unlink(tempPath);
+}
+
 void GameDetector::DetectGameEngine()
+{
+    char buildId[256];
+    bool haveBuildId = gameName_.length() && !strpbrk(gameName_.chars(), " \t\n") &&
+                       GetEngineBuildId(buildId, sizeof(buildId));
+    
+    // The branch only changes with a new build of the libraries it is probed from, so they don't
+    // have to be loaded to probe their interfaces again
+    if (haveBuildId && LoadCachedEngine(buildId))
+        return;
+    
+    ProbeGameEngine();
+    
+    if (haveBuildId && gameEngine_ != Engine_Unknown)
+        SaveCachedEngine(buildId);
+}
+
+void GameDetector::ProbeGameEngine()
 {
     GameLib engine("engine");
     GameLib vstdlib("vstdlib");
@@ -64,6 +64,9 @@ public:
 private:
     void DetectGameName(int argc, char *argv[]);
     void DetectGameEngine();
+    void ProbeGameEngine();
+    bool LoadCachedEngine(const char *buildId);
+    void SaveCachedEngine(const char *buildId);
 private:
     bool initialized_;
     EngineBranch gameEngine_;
@@ -0,0 +1,672 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "GameIndex.h"
+#include "DirScan.h"
+#include "CacheDir.h"
+#include "platform.h"
+
+#if defined(PLATFORM_MACOSX)
+#include <sys/event.h>
+#elif defined(PLATFORM_LINUX)
+#include <sys/inotify.h>
+#endif
+
+#define GAME_INDEX_FILE SRCDS_CACHE_DIR "/game_index"
+#define GAME_INDEX_HEADER "srcds_game_index 1"
+
+// Most directories that are watched. Every watch costs a file descriptor on OS X (two for a game
+// directory), so large Steam libraries fall back to modification time checks for the rest.
+#define GAME_INDEX_MAX_WATCHED 64
+
+// Returns the modification time of a file or directory, or 0 if it doesn't exist
+static time_t GetModTime(const char *path)
+{
+    struct stat st;
+    
+    if (stat(path, &st) != 0)
+        return 0;
+    
+    return st.st_mtime;
+}
+
+// A valid game directory contains a 'bin' directory and a file named 'gameinfo.txt'
+static bool IsGameDirectory(const char *gamedir)
+{
+    DirReader reader;
+    
+    if (!reader.Open(gamedir))
+        return false;
+    
+    bool isValid = false;
+    bool hasBinaries = false;
+    bool hasGameInfo = false;
+    const char *name;
+    unsigned char type;
+    
+    while ((name = reader.Next(&type)) != nullptr)
+    {
+        bool isBin = strcasecmp(name, "bin") == 0;
+        
+        if (isBin || strcasecmp(name, "gameinfo.txt") == 0)
+        {
+            bool isDir = type == DT_DIR;
+            
+            // Symbolic links and file systems that don't report types need a closer look
+            if (type == DT_UNKNOWN || type == DT_LNK)
+            {
+                AString path(gamedir);
+                path.append(PLATFORM_SEP);
+                path.append(name);
+                
+                struct stat st;
+                isDir = stat(path.chars(), &st) == 0 && S_ISDIR(st.st_mode);
+            }
+            
+            if (isBin != isDir)
+                break;
+            
+            if (isBin)
+                hasBinaries = true;
+            else
+                hasGameInfo = true;
+        }
+        
+        if (hasBinaries && hasGameInfo)
+        {
+            isValid = true;
+            break;
+        }
+    }
+    
+    return isValid;
+}
+
+GameIndex::GameIndex()
+    : rootTime_(0), loaded_(false), rootDirty_(true), modified_(false), watcher_(-1),
+      rootWatch_(-1), watchCount_(0)
+{
+
+}
+
+GameIndex::~GameIndex()
+{
+    for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); iter++)
+        Unwatch(*iter);
+    
+#if defined(PLATFORM_MACOSX)
+    if (rootWatch_ != -1)
+        close(rootWatch_);
+#endif
+    
+    if (watcher_ != -1)
+        close(watcher_);
+}
+
+void GameIndex::BuildGameList(LinkedList<game_t> &gameList, DescribeFn describe)
+{
+    if (!loaded_)
+    {
+        Load();
+        loaded_ = true;
+        
+#if defined(PLATFORM_MACOSX)
+        watcher_ = kqueue();
+        
+        if (watcher_ != -1 && (rootWatch_ = open(".", O_EVTONLY)) != -1)
+        {
+            struct kevent ev;
+            EV_SET(&ev, rootWatch_, EVFILT_VNODE, EV_ADD | EV_CLEAR, NOTE_WRITE, 0, nullptr);
+            
+            if (kevent(watcher_, &ev, 1, nullptr, 0, nullptr) == -1)
+            {
+                close(rootWatch_);
+                rootWatch_ = -1;
+            }
+        }
+#elif defined(PLATFORM_LINUX)
+        watcher_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        
+        if (watcher_ != -1)
+        {
+            rootWatch_ = inotify_add_watch(watcher_, ".", IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                           IN_MOVED_TO | IN_ATTRIB);
+        }
+#endif
+        
+        if (watcher_ != -1 && rootWatch_ == -1)
+        {
+            close(watcher_);
+            watcher_ = -1;
+        }
+    }
+    else if (watcher_ != -1)
+    {
+        PollWatcher();
+    }
+    
+    // Without a watcher nothing says what changed, so everything has to be checked
+    if (watcher_ == -1)
+        rootDirty_ = true;
+    
+    if (rootDirty_)
+        ScanRoot();
+    
+    CheckEntries(describe);
+    
+    if (modified_)
+        Save();
+    
+    for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); iter++)
+    {
+        if (iter->valid)
+        {
+            game_t game;
+            game.gameDirectory = iter->directory;
+            game.gameDescription = iter->description;
+            gameList.append(game);
+        }
+    }
+}
+
+void GameIndex::Load()
+{
+    FILE *fp = fopen(GAME_INDEX_FILE, "r");
+    
+    if (!fp)
+        return;
+    
+    char line[2048];
+    long long rootTime;
+    
+    if (!fgets(line, sizeof(line), fp) ||
+        sscanf(line, GAME_INDEX_HEADER " %lld", &rootTime) != 1)
+    {
+        fclose(fp);
+        return;
+    }
+    
+    rootTime_ = time_t(rootTime);
+    
+    // <dir time> <gameinfo time> <valid> <directory> <description>, separated by tabs
+    while (fgets(line, sizeof(line), fp))
+    {
+        char *fields[5];
+        char *pos = line;
+        size_t count = 0;
+        
+        line[strcspn(line, "\r\n")] = '\0';
+        
+        while (count < 5)
+        {
+            fields[count++] = pos;
+            
+            if ((pos = strchr(pos, '\t')) == nullptr)
+                break;
+            
+            *pos++ = '\0';
+        }
+        
+        if (count != 5 || !fields[3][0])
+            continue;
+        
+        Entry entry;
+        entry.dirTime = time_t(atoll(fields[0]));
+        entry.infoTime = time_t(atoll(fields[1]));
+        entry.valid = atoi(fields[2]) != 0;
+        entry.directory = fields[3];
+        entry.description = fields[4];
+        entry.dirty = true;
+        entry.present = true;
+        entry.watch = -1;
+        entry.infoWatch = -1;
+        entry.watchDev = 0;
+        entry.watchIno = 0;
+        
+        entries_.append(entry);
+    }
+    
+    fclose(fp);
+}
+
+void GameIndex::Save()
+{
+    if (!MakeCacheDir())
+        return;
+    
+    char tempPath[64];
+    snprintf(tempPath, sizeof(tempPath), GAME_INDEX_FILE ".%d", (int)getpid());
+    
+    FILE *fp = fopen(tempPath, "w");
+    
+    if (!fp)
+        return;
+    
+    fprintf(fp, GAME_INDEX_HEADER " %lld\n", (long long)rootTime_);
+    
+    for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); iter++)
+    {
+        // Names that can't be stored are checked again next time
+        if (strpbrk(iter->directory.chars(), "\t\r\n") || strpbrk(iter->description.chars(), "\t\r\n"))
+            continue;
+        
+        fprintf(fp, "%lld\t%lld\t%d\t%s\t%s\n", (long long)iter->dirTime, (long long)iter->infoTime,
+                iter->valid ? 1 : 0, iter->directory.chars(), iter->description.chars());
+    }
+    
+    // Readers only ever see a complete file
+    if (fclose(fp) != 0 || rename(tempPath, GAME_INDEX_FILE) != 0)
+        unlink(tempPath);
+    
+    modified_ = false;
+}
+
+void GameIndex::ScanRoot()
+{
+    rootDirty_ = false;
+    
+    // Directories can only have been added or removed if the root has changed
+    time_t rootTime = GetModTime(".");
+    
+    if (rootTime && rootTime == rootTime_)
+        return;
+    
+    DirReader reader;
+    
+    if (!reader.Open("."))
+        return;
+    
+    rootTime_ = rootTime;
+    modified_ = true;
+    
+    for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); iter++)
+        iter->present = false;
+    
+    const char *name;
+    unsigned char type;
+    
+    while ((name = reader.Next(&type)) != nullptr)
+    {
+        if (name[0] == '.')
+            continue;
+        
+        struct stat st;
+        
+        if (type != DT_DIR && (stat(name, &st) != 0 || !S_ISDIR(st.st_mode)))
+            continue;
+        
+        LinkedList<Entry>::iterator iter = entries_.begin();
+        
+        while (iter != entries_.end() && iter->directory.compare(name) != 0)
+            iter++;
+        
+        if (iter != entries_.end())
+        {
+            iter->present = true;
+            
+            // The watch follows the directory it was added for, so a directory that was renamed
+            // away and replaced by a new one with the same name has to be watched again
+            if (iter->watch != -1 &&
+                (stat(name, &st) != 0 || st.st_dev != iter->watchDev || st.st_ino != iter->watchIno))
+            {
+                Unwatch(*iter);
+                iter->dirty = true;
+            }
+            
+            continue;
+        }
+        
+        Entry entry;
+        entry.directory = name;
+        entry.dirTime = 0;
+        entry.infoTime = 0;
+        entry.valid = false;
+        entry.dirty = true;
+        entry.present = true;
+        entry.watch = -1;
+        entry.infoWatch = -1;
+        entry.watchDev = 0;
+        entry.watchIno = 0;
+        
+        entries_.append(entry);
+    }
+    
+    reader.Close();
+    
+    for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); )
+    {
+        if (iter->present)
+        {
+            iter++;
+            continue;
+        }
+        
+        Unwatch(*iter);
+        iter = entries_.erase(iter);
+    }
+}
+
+void GameIndex::CheckEntries(DescribeFn describe)
+{
+    size_t count = 0;
+    
+    for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); iter++)
+    {
+        if (iter->dirty || iter->watch == -1)
+            count++;
+    }
+    
+    if (!count)
+        return;
+    
+    EntryCheck *checks = new EntryCheck[count];
+    size_t index = 0;
+    
+    for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); iter++)
+    {
+        if (!iter->dirty && iter->watch != -1)
+            continue;
+        
+        iter->dirty = false;
+        
+        // Start watching before looking, so nothing that changes afterward is missed
+        Watch(*iter);
+        
+        checks[index].entry = &*iter;
+        checks[index].describe = describe;
+        checks[index].changed = false;
+        index++;
+    }
+    
+    // Listing a directory and parsing its gameinfo.txt don't depend on the others
+    ParallelFor(count, CheckEntry, checks);
+    
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!checks[i].changed)
+            continue;
+        
+        modified_ = true;
+        
+        // A new gameinfo.txt needs its own watch on OS X
+        Watch(*checks[i].entry);
+    }
+    
+    delete [] checks;
+}
+
+void GameIndex::CheckEntry(void *data, size_t index)
+{
+    EntryCheck &check = ((EntryCheck *)data)[index];
+    Entry &entry = *check.entry;
+    
+    const char *dir = entry.directory.chars();
+    AString gameinfo(dir);
+    gameinfo.append(PLATFORM_SEP "gameinfo.txt");
+    
+    time_t dirTime = GetModTime(dir);
+    time_t infoTime = GetModTime(gameinfo.chars());
+    
+    if (dirTime && dirTime == entry.dirTime && infoTime == entry.infoTime)
+        return;
+    
+    entry.dirTime = dirTime;
+    entry.infoTime = infoTime;
+    entry.valid = IsGameDirectory(dir);
+    entry.description = entry.valid ? check.describe(dir) : AString();
+    check.changed = true;
+}
+
+void GameIndex::PollWatcher()
+{
+#if defined(PLATFORM_MACOSX)
+    struct kevent events[64];
+    struct timespec timeout = {0, 0};
+    int count;
+    
+    while ((count = kevent(watcher_, nullptr, 0, events, 64, &timeout)) > 0)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            const struct kevent &ev = events[i];
+            
+            if (int(ev.ident) == rootWatch_)
+            {
+                rootDirty_ = true;
+                continue;
+            }
+            
+            Entry *entry = (Entry *)ev.udata;
+            entry->dirty = true;
+            
+            // Files that have been replaced have to be watched again. A directory that was deleted
+            // or renamed away drops its watches, and a new one with that name is picked up by the
+            // root listing.
+            if (ev.fflags & (NOTE_DELETE | NOTE_RENAME))
+            {
+                if (int(ev.ident) == entry->infoWatch)
+                {
+                    close(entry->infoWatch);
+                    entry->infoWatch = -1;
+                    watchCount_--;
+                }
+                else if (int(ev.ident) == entry->watch)
+                {
+                    Unwatch(*entry);
+                    rootDirty_ = true;
+                }
+            }
+        }
+        
+        if (count < 64)
+            break;
+    }
+#elif defined(PLATFORM_LINUX)
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    
+    while ((len = read(watcher_, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *pos = buffer; pos < buffer + len; )
+        {
+            const struct inotify_event *event = (const struct inotify_event *)pos;
+            pos += sizeof(struct inotify_event) + event->len;
+            
+            // Events were lost, so everything has to be checked
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                rootDirty_ = true;
+                
+                for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end();
+                     iter++)
+                {
+                    iter->dirty = true;
+                }
+                
+                continue;
+            }
+            
+            // Hidden entries (like the cache directory) are never games
+            if (event->wd == rootWatch_)
+            {
+                if (!event->len || event->name[0] != '.')
+                    rootDirty_ = true;
+                
+                continue;
+            }
+            
+            // Other files in a game directory can be written all the time, so only changes to
+            // gameinfo.txt and to the entries of the directory count
+            if (!(event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                 IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) &&
+                (!event->len || strcasecmp(event->name, "gameinfo.txt") != 0))
+            {
+                continue;
+            }
+            
+            for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); iter++)
+            {
+                if (iter->watch != event->wd)
+                    continue;
+                
+                iter->dirty = true;
+                
+                // The watch is gone after IN_IGNORED. One on a directory that was renamed away
+                // would keep following it, so it is dropped (its IN_IGNORED then matches nothing).
+                if (event->mask & IN_IGNORED)
+                {
+                    iter->watch = -1;
+                    watchCount_--;
+                    rootDirty_ = true;
+                }
+                else if (event->mask & IN_MOVE_SELF)
+                {
+                    Unwatch(*iter);
+                    rootDirty_ = true;
+                }
+                
+                break;
+            }
+        }
+    }
+#endif
+}
+
+void GameIndex::Watch(Entry &entry)
+{
+    if (watcher_ == -1)
+        return;
+    
+#if defined(PLATFORM_MACOSX)
+    struct kevent ev;
+    
+    if (entry.watch == -1 && watchCount_ < GAME_INDEX_MAX_WATCHED)
+    {
+        entry.watch = open(entry.directory.chars(), O_EVTONLY);
+        
+        if (entry.watch != -1)
+        {
+            struct stat st;
+            
+            EV_SET(&ev, entry.watch, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+                   NOTE_WRITE | NOTE_DELETE | NOTE_RENAME, 0, &entry);
+            
+            if (fstat(entry.watch, &st) != 0 || kevent(watcher_, &ev, 1, nullptr, 0, nullptr) == -1)
+            {
+                close(entry.watch);
+                entry.watch = -1;
+            }
+            else
+            {
+                entry.watchDev = st.st_dev;
+                entry.watchIno = st.st_ino;
+                watchCount_++;
+            }
+        }
+    }
+    
+    // The description can change without the directory changing
+    if (entry.watch != -1 && entry.valid && entry.infoWatch == -1 &&
+        watchCount_ < GAME_INDEX_MAX_WATCHED)
+    {
+        AString gameinfo(entry.directory);
+        gameinfo.append(PLATFORM_SEP "gameinfo.txt");
+        
+        entry.infoWatch = open(gameinfo.chars(), O_EVTONLY);
+        
+        if (entry.infoWatch != -1)
+        {
+            EV_SET(&ev, entry.infoWatch, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+                   NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB | NOTE_DELETE | NOTE_RENAME, 0, &entry);
+            
+            if (kevent(watcher_, &ev, 1, nullptr, 0, nullptr) == -1)
+            {
+                close(entry.infoWatch);
+                entry.infoWatch = -1;
+            }
+            else
+            {
+                watchCount_++;
+            }
+        }
+    }
+#elif defined(PLATFORM_LINUX)
+    struct stat st;
+    
+    // The directory is looked at first, so if it is replaced before the watch is added, the root
+    // listing sees that the watch isn't on the directory that was recorded
+    if (entry.watch == -1 && watchCount_ < GAME_INDEX_MAX_WATCHED &&
+        stat(entry.directory.chars(), &st) == 0)
+    {
+        entry.watch = inotify_add_watch(watcher_, entry.directory.chars(), IN_CREATE | IN_DELETE |
+                                        IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE |
+                                        IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+        
+        if (entry.watch != -1)
+        {
+            entry.watchDev = st.st_dev;
+            entry.watchIno = st.st_ino;
+            watchCount_++;
+        }
+    }
+#endif
+}
+
+void GameIndex::Unwatch(Entry &entry)
+{
+#if defined(PLATFORM_MACOSX)
+    // Closing the descriptors removes their events from the queue
+    if (entry.infoWatch != -1)
+    {
+        close(entry.infoWatch);
+        watchCount_--;
+    }
+    
+    if (entry.watch != -1)
+    {
+        close(entry.watch);
+        watchCount_--;
+    }
+#elif defined(PLATFORM_LINUX)
+    if (entry.watch != -1)
+    {
+        inotify_rm_watch(watcher_, entry.watch);
+        watchCount_--;
+    }
+#endif
+    
+    entry.watch = -1;
+    entry.infoWatch = -1;
+}
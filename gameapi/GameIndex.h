@@ -0,0 +1,102 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_GAMEINDEX_H_
+#define _INCLUDE_SRCDS_GAMEINDEX_H_
+
+#include <time.h>
+#include <sys/types.h>
+#include "IGameAPI.h"
+#include "am-string.h"
+#include "am-linkedlist.h"
+
+using namespace ke;
+
+// Index of the game directories in the server directory for BuildGameList. For every directory it
+// keeps whether it is a game (has a bin directory and a gameinfo.txt) and the game's description,
+// along with the modification times they were taken from. The index is saved to
+// .srcds_cache/game_index so the next run only has to stat each directory.
+//
+// While the process runs, the directories are watched (kqueue on OS X, inotify on Linux), so a
+// repeated listing only looks at the directories that changed. Without a watcher, every listing
+// compares modification times instead.
+class GameIndex
+{
+public:
+    typedef AString (*DescribeFn)(const char *gamedir);
+    
+    GameIndex();
+    ~GameIndex();
+    
+    // Brings the index up to date and appends the game directories to gameList. describe returns
+    // the description of a game directory whose gameinfo.txt is new or has changed.
+    void BuildGameList(LinkedList<game_t> &gameList, DescribeFn describe);
+private:
+    struct Entry
+    {
+        AString directory;
+        AString description;
+        time_t dirTime;         // Modification time of the directory when it was checked
+        time_t infoTime;        // Modification time of gameinfo.txt, 0 if there isn't one
+        bool valid;
+        bool dirty;             // Needs its modification times checked
+        bool present;           // Seen in the last listing of the server directory
+        int watch;              // kqueue fd or inotify watch descriptor, -1 if not watched
+        int infoWatch;          // kqueue fd of gameinfo.txt (OS X only)
+        dev_t watchDev;         // Device and inode of the watched directory, so a directory that
+        ino_t watchIno;         // is replaced by another one with the same name is noticed
+    };
+    
+    // A directory that is checked on one of the ParallelFor threads
+    struct EntryCheck
+    {
+        Entry *entry;
+        DescribeFn describe;
+        bool changed;
+    };
+    
+    void Load();
+    void Save();
+    void ScanRoot();
+    void CheckEntries(DescribeFn describe);
+    static void CheckEntry(void *data, size_t index);
+    void PollWatcher();
+    void Watch(Entry &entry);
+    void Unwatch(Entry &entry);
+private:
+    LinkedList<Entry> entries_;
+    time_t rootTime_;
+    bool loaded_;
+    bool rootDirty_;
+    bool modified_;             // Needs to be saved
+    int watcher_;               // kqueue or inotify fd, -1 if there isn't one
+    int rootWatch_;
+    int watchCount_;
+};
+
+#endif // _INCLUDE_SRCDS_GAMEINDEX_H_
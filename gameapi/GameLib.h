@@ -58,6 +58,9 @@ public:
     
     virtual bool Load(const char *name);
     void Close();
+    
+    // Loads libraries with RTLD_NOW instead of RTLD_LAZY
+    static void SetBindNow(bool enable);
 
     template <typename T>
     T ResolveSymbol(const char *symbol)
@@ -80,12 +83,16 @@ private:
     GameLib &operator =(const GameLib &other);
 
     void *GetSymbolAddr(const char *symbol);
+    bool TryCandidate(const char *key, const AString &candidate, bool overridden);
     bool TryLoad();
 protected:
     AString name_;
+    AString key_;
     const char *shortName_;
     LibHandle handle_;
     bool overridden_;
+private:
+    static bool bindNow_;
 };
 
 #endif // _INCLUDE_SRCDS_GAMELIB_H_
@@ -0,0 +1,251 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include "GameLibCache.h"
+#include "platform.h"
+
+#if defined(PLATFORM_MACOSX)
+#define LIBEXT ".dylib"
+#else
+#define LIBEXT ".so"
+#endif
+
+// Marks a file that exists in the files_ table
+#define FILE_PRESENT ((void *)1)
+
+struct ResolvedLib
+{
+    LibHandle handle;
+    unsigned int refs;
+    bool overridden;
+    char path[1];
+};
+
+GameLibCache &GameLibCache::GetInstance()
+{
+    static GameLibCache cache;
+    return cache;
+}
+
+GameLibCache::GameLibCache()
+{
+    pthread_mutex_init(&lock_, nullptr);
+    files_.Initialize();
+    resolved_.Initialize();
+}
+
+bool GameLibCache::FindResolved(const char *key, AString *path, bool *overridden,
+                                LibHandle *handle)
+{
+    pthread_mutex_lock(&lock_);
+    
+    Symbol *entry = resolved_.FindSymbol(key, strlen(key));
+    
+    if (entry)
+    {
+        ResolvedLib *lib = (ResolvedLib *)entry->address;
+        *path = lib->path;
+        *overridden = lib->overridden;
+        *handle = lib->handle;
+        
+        if (lib->handle)
+            lib->refs++;
+    }
+    
+    pthread_mutex_unlock(&lock_);
+    
+    return entry != nullptr;
+}
+
+LibHandle GameLibCache::SetResolved(const char *key, const char *path, bool overridden,
+                                    LibHandle handle)
+{
+    pthread_mutex_lock(&lock_);
+    
+    Symbol *entry = resolved_.FindSymbol(key, strlen(key));
+    ResolvedLib *lib = entry ? (ResolvedLib *)entry->address : nullptr;
+    
+    // A closed library that now loads from somewhere else gets a new entry
+    if (!lib || (!lib->handle && strcmp(lib->path, path) != 0))
+    {
+        size_t len = strlen(path);
+        ResolvedLib *newLib = (ResolvedLib *)malloc(sizeof(ResolvedLib) + len);
+        
+        if (!newLib)
+        {
+            pthread_mutex_unlock(&lock_);
+            return handle;
+        }
+        
+        newLib->handle = nullptr;
+        newLib->refs = 0;
+        newLib->overridden = overridden;
+        memcpy(newLib->path, path, len + 1);
+        
+        if (entry)
+        {
+            free(lib);
+            entry->address = newLib;
+        }
+        else
+        {
+            resolved_.InternSymbol(key, strlen(key), newLib);
+        }
+        
+        lib = newLib;
+    }
+    
+    LibHandle extra = nullptr;
+    
+    // Another thread opened the library in the meantime, so its handle is shared instead
+    if (lib->handle)
+        extra = handle;
+    else
+        lib->handle = handle;
+    
+    lib->refs++;
+    handle = lib->handle;
+    
+    pthread_mutex_unlock(&lock_);
+    
+    if (extra)
+        dlclose(extra);
+    
+    return handle;
+}
+
+void GameLibCache::Release(const char *key)
+{
+    LibHandle handle = nullptr;
+    
+    pthread_mutex_lock(&lock_);
+    
+    Symbol *entry = resolved_.FindSymbol(key, strlen(key));
+    
+    if (entry)
+    {
+        ResolvedLib *lib = (ResolvedLib *)entry->address;
+        
+        if (lib->refs && --lib->refs == 0)
+        {
+            handle = lib->handle;
+            lib->handle = nullptr;
+        }
+    }
+    
+    pthread_mutex_unlock(&lock_);
+    
+    if (handle)
+        dlclose(handle);
+}
+
+bool GameLibCache::IsKnownMissing(const char *candidate)
+{
+    char key[PATH_MAX + 256];
+    size_t len = MakeKey(candidate, key, sizeof(key));
+    
+    if (!len)
+        return false;
+    
+    pthread_mutex_lock(&lock_);
+    
+    // Candidates in a subdirectory can only be loaded from there, so its listing is complete. The
+    // directory is listed the first time it comes up. dlopen() searches more places for plain
+    // names than could be listed, so those are always tried.
+    bool result = false;
+    
+    if (strchr(candidate, '/'))
+    {
+        size_t dirLen = strrchr(key, '/') - key + 1;
+        Symbol *dirEntry = files_.FindSymbol(key, dirLen);
+        
+        if (!dirEntry)
+        {
+            AString dir(key, dirLen);
+            bool listed = ScanDirectory(dir.chars());
+            dirEntry = files_.InternSymbol(dir.chars(), dirLen, listed ? FILE_PRESENT : nullptr);
+        }
+        
+        result = dirEntry->address && !files_.FindSymbol(key, len);
+    }
+    
+    pthread_mutex_unlock(&lock_);
+    
+    return result;
+}
+
+size_t GameLibCache::MakeKey(const char *candidate, char *key, size_t maxlength)
+{
+    size_t len;
+    
+    if (candidate[0] == '/')
+        len = snprintf(key, maxlength, "%s", candidate);
+    else if (getcwd(key, maxlength))
+        len = strlen(key) + snprintf(&key[strlen(key)], maxlength - strlen(key), "/%s", candidate);
+    else
+        return 0;
+    
+    return len < maxlength ? len : 0;
+}
+
+bool GameLibCache::ScanDirectory(const char *dir)
+{
+    DIR *dp = opendir(dir);
+    
+    // Nothing can be loaded from a directory that doesn't exist. One that can't be read may still
+    // have the file, so nothing is known about it.
+    if (!dp)
+        return errno == ENOENT || errno == ENOTDIR;
+    
+    char path[PATH_MAX + 256];
+    struct dirent *ent;
+    
+    while ((ent = readdir(dp)) != nullptr)
+    {
+        if (!strstr(ent->d_name, LIBEXT))
+            continue;
+        
+        size_t len = snprintf(path, sizeof(path), "%s%s", dir, ent->d_name);
+        
+        if (len >= sizeof(path))
+            continue;
+        
+        files_.InternSymbol(path, len, FILE_PRESENT);
+    }
+    
+    closedir(dp);
+    return true;
+}
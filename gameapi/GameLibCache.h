@@ -0,0 +1,88 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_GAMELIBCACHE_H_
+#define _INCLUDE_SRCDS_GAMELIBCACHE_H_
+
+#include <pthread.h>
+#include "am-string.h"
+#include "GameLib.h"
+#include "sm_symtable.h"
+
+using namespace ke;
+
+// Process-wide record of where game libraries were found, so GameLib::Load only has to probe
+// for each library once. The directories of relative candidates (i.e. override libraries) are
+// listed, so files that don't exist there are skipped without a failed dlopen() for each of them.
+// Other failures are not remembered, since a library that failed to load (e.g. because of a
+// missing dependency) may load the next time. Entries are keyed by the working directory, since
+// relative names and the search of the working directory depend on it.
+//
+// Open libraries are shared by every GameLib that loads them, with a reference count kept here,
+// so loading a library that is already open is a hash lookup.
+class GameLibCache
+{
+public:
+    static GameLibCache &GetInstance();
+    
+    // Looks up the file that was loaded for key before and returns false if there isn't one. If
+    // the library is still open, *handle gets a new reference to it and nothing has to be loaded.
+    bool FindResolved(const char *key, AString *path, bool *overridden, LibHandle *handle);
+    
+    // Records the file that was loaded for key and takes over the reference to handle. Returns the
+    // handle to use, which is the registered one if another thread got there first.
+    LibHandle SetResolved(const char *key, const char *path, bool overridden, LibHandle handle);
+    
+    // Drops a reference taken by FindResolved or SetResolved. The library is closed with the last.
+    void Release(const char *key);
+    
+    // Returns true if the candidate is in a subdirectory whose listing doesn't have it
+    bool IsKnownMissing(const char *candidate);
+private:
+    GameLibCache();
+    
+    // Puts the working directory in front of relative candidates. Returns the key length, or 0 if
+    // it doesn't fit.
+    size_t MakeKey(const char *candidate, char *key, size_t maxlength);
+    
+    // Adds the libraries in dir to files_. Returns false if the directory couldn't be listed
+    // although it exists.
+    bool ScanDirectory(const char *dir);
+private:
+    // Files that were seen in the directory listings, along with the directories that have been
+    // listed (which end with a slash). A directory with a null address couldn't be listed.
+    SymbolTable files_;
+    
+    // Lookup keys of libraries that have been loaded, pointing at a ResolvedLib that holds the
+    // handle while the library is open
+    SymbolTable resolved_;
+    
+    pthread_mutex_t lock_;
+};
+
+#endif // _INCLUDE_SRCDS_GAMELIBCACHE_H_
@@ -33,6 +33,8 @@
 #include "GameLib.h"
 #include "GameDetector.h"
 #include "GameAPI.h"
+#include "GameLibCache.h"
+#include "StartupTrace.h"
 
 #if defined(PLATFORM_MACOSX)
 #define LIBEXT ".dylib"
@@ -40,6 +42,8 @@
 #define LIBEXT ".so"
 #endif
 
+bool GameLib::bindNow_ = false;
+
 GameLib::GameLib() : handle_(nullptr), shortName_(nullptr), overridden_(false)
 {
 
@@ -70,89 +74,120 @@ bool GameLib::IsOverridden() const
     return overridden_;
 }
 
+// Most file names GameLib::Load can try for one library
+#define MAX_CANDIDATES 6
+
 bool GameLib::Load(const char *name)
 {
     if (IsLoaded())
         Close();
     
+    TRACE_SCOPE("GameLib::Load", name);
+    
     shortName_ = name;
+    overridden_ = false;
     
     GameDetector &detector = GameAPI::GetInstance().GetGameDetector();
+    GameLibCache &cache = GameLibCache::GetInstance();
+    
+    AString candidates[MAX_CANDIDATES];
+    bool overrides[MAX_CANDIDATES] = {false};
+    size_t count = 0;
+    
+    // Override libraries can only be looked for once the game is known, so it is part of the key
+    AString key(name);
     
     // Look for special override libraries that have a .ovrd suffix
     if (detector.IsInitialized())
     {
-        // Try game-specific version of library first
-        name_ = "game/";
-        name_.append(detector.GetGameName());
-        name_.append("/");
-        name_.append(name);
-        name_.append(".ovrd" LIBEXT);
+        key.append(":");
+        key.append(detector.GetGameName());
+        key.append(":");
+        key.append(detector.GetEngineString());
         
-        if (TryLoad())
-        {
-            overridden_ = true;
-            return IsLoaded();
-        }
+        // Try game-specific version of library first
+        candidates[count] = "game/";
+        candidates[count].append(detector.GetGameName());
+        candidates[count].append("/");
+        candidates[count].append(name);
+        candidates[count].append(".ovrd" LIBEXT);
+        overrides[count++] = true;
         
         // Next try engine-specific version
-        name_ = "engine/";
-        name_.append(detector.GetEngineString());
-        name_.append("/");
-        name_.append(name);
-        name_.append(".ovrd" LIBEXT);
-        
-        if (TryLoad())
-        {
-            overridden_ = true;
-            return IsLoaded();
-        }
+        candidates[count] = "engine/";
+        candidates[count].append(detector.GetEngineString());
+        candidates[count].append("/");
+        candidates[count].append(name);
+        candidates[count].append(".ovrd" LIBEXT);
+        overrides[count++] = true;
     }
-
-    name_ = name;
     
 #if defined(PLATFORM_LINUX)
     // On Linux, look for libraries with _srv suffix first
-    name_.append("_srv" LIBEXT);
+    candidates[count] = name;
+    candidates[count++].append("_srv" LIBEXT);
     
-    if (TryLoad())
-        return IsLoaded();
+    candidates[count] = name;
+    candidates[count++].append(LIBEXT);
     
-    name_ = name;
-    name_.append(LIBEXT);
+    candidates[count] = "lib";
+    candidates[count].append(name);
+    candidates[count++].append("_srv" LIBEXT);
     
-    if (TryLoad())
-        return IsLoaded();
-
-    name_ = "lib";
-    name_.append(name);
-    name_.append("_srv" LIBEXT);
-    
-    if (TryLoad())
-        return IsLoaded();
-
-    name_ = "lib";
-    name_.append(name);
-    name_.append(LIBEXT);
+    candidates[count] = "lib";
+    candidates[count].append(name);
+    candidates[count++].append(LIBEXT);
 #else
-    name_.append(LIBEXT);
+    candidates[count] = name;
+    candidates[count++].append(LIBEXT);
     
-    if (TryLoad())
-        return IsLoaded();
-    
-    name_ = "lib";
-    name_.append(name);
-    name_.append(LIBEXT);
+    candidates[count] = "lib";
+    candidates[count].append(name);
+    candidates[count++].append(LIBEXT);
 #endif
     
-    return TryLoad();
+    key_ = key;
+    
+    // A library is found in the same place every time, so only the first load has to probe. If
+    // it is still open, this just takes another reference to it.
+    if (cache.FindResolved(key.chars(), &name_, &overridden_, &handle_))
+    {
+        if (handle_)
+            return true;
+        
+        if (TryLoad())
+        {
+            handle_ = cache.SetResolved(key.chars(), name_.chars(), overridden_, handle_);
+            return true;
+        }
+        
+        overridden_ = false;
+    }
+    
+    // Try the candidates in order, skipping the ones that are known not to exist
+    for (size_t i = 0; i < count; i++)
+    {
+        if (cache.IsKnownMissing(candidates[i].chars()))
+            continue;
+        
+        if (TryCandidate(key.chars(), candidates[i], overrides[i]))
+            return true;
+    }
+    
+    return false;
+}
+
+void GameLib::SetBindNow(bool enable)
+{
+    bindNow_ = enable;
 }
 
 void GameLib::Close()
 {
     if (handle_)
     {
-        dlclose(handle_);
+        // The cache closes the library once nothing else has it open
+        GameLibCache::GetInstance().Release(key_.chars());
         handle_ = nullptr;
     }
 }
@@ -162,9 +197,34 @@ void *GameLib::GetSymbolAddr(const char *symbol)
     return dlsym(handle_, symbol);
 }
 
+bool GameLib::TryCandidate(const char *key, const AString &candidate, bool overridden)
+{
+    GameLibCache &cache = GameLibCache::GetInstance();
+    
+    name_ = candidate;
+    
+    if (!TryLoad())
+        return false;
+    
+    overridden_ = overridden;
+    handle_ = cache.SetResolved(key, name_.chars(), overridden, handle_);
+    
+    return true;
+}
+
 bool GameLib::TryLoad()
 {
-    handle_ = dlopen(name_.chars(), RTLD_LAZY);
+    TRACE_SCOPE("dlopen", name_.chars());
+    
+    int mode = bindNow_ ? RTLD_NOW : RTLD_LAZY;
+    
+    // Libraries the engine has loaded itself are found without searching for the file
+    handle_ = dlopen(name_.chars(), mode | RTLD_NOLOAD);
+    
+    if (!handle_)
+        handle_ = dlopen(name_.chars(), mode);
+    
+    TRACE_SCOPE_FAILED(!IsLoaded());
     return IsLoaded();
 }
 
@@ -0,0 +1,89 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <string.h>
+#include "HdrHistogram.h"
+
+HdrHistogram::HdrHistogram()
+{
+    Reset();
+}
+
+void HdrHistogram::Reset()
+{
+    memset((void *)counts_, 0, sizeof(counts_));
+    total_ = 0;
+    max_ = 0;
+}
+
+uint64_t HdrHistogram::ValueOf(int index)
+{
+    int bucket = (index < kSubBuckets) ? 0 : (index >> (kSubBucketBits - 1)) - 1;
+    uint64_t subBucket = index - (bucket << (kSubBucketBits - 1));
+    
+    return ((subBucket + 1) << bucket) - 1;
+}
+
+void HdrHistogram::Snapshot(hdr_stats_t *stats) const
+{
+    static const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+    uint64_t *results[] = {&stats->p50, &stats->p90, &stats->p99, &stats->p999, &stats->p9999};
+    
+    // Counters keep changing while this runs, so work on a copy
+    uint32_t counts[kNumCounts];
+    uint64_t total = 0;
+    
+    for (int i = 0; i < kNumCounts; i++)
+    {
+        counts[i] = counts_[i];
+        total += counts[i];
+    }
+    
+    memset(stats, 0, sizeof(hdr_stats_t));
+    stats->count = total;
+    stats->max = max_;
+    
+    if (total == 0)
+        return;
+    
+    uint64_t seen = 0;
+    size_t next = 0;
+    
+    for (int i = 0; i < kNumCounts && next < ARRAY_LENGTH(percentiles); i++)
+    {
+        seen += counts[i];
+        
+        while (next < ARRAY_LENGTH(percentiles) && seen * 100.0 >= percentiles[next] * total)
+        {
+            uint64_t value = ValueOf(i);
+            
+            // Bucket bounds can be a little above the real maximum
+            *results[next++] = (value < stats->max) ? value : stats->max;
+        }
+    }
+}
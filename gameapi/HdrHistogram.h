@@ -0,0 +1,84 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_HDRHISTOGRAM_H_
+#define _INCLUDE_SRCDS_HDRHISTOGRAM_H_
+
+#include <stdint.h>
+#include "IGameAPI.h"
+
+// Log-linear (HDR) histogram of nanosecond values with about 1% precision, from 1 ns up to about
+// 68 seconds. Recording is lock-free and wait-free apart from updating the maximum, so it can be
+// done from the server frame while another thread takes snapshots.
+class HdrHistogram
+{
+public:
+    HdrHistogram();
+    
+    inline void Record(uint64_t value)
+    {
+        __sync_fetch_and_add(&counts_[IndexOf(value)], 1);
+        __sync_fetch_and_add(&total_, 1);
+        
+        uint64_t max = max_;
+        while (value > max && !__sync_bool_compare_and_swap(&max_, max, value))
+            max = max_;
+    }
+    
+    // Computes percentiles from the values recorded so far
+    void Snapshot(hdr_stats_t *stats) const;
+    
+    void Reset();
+private:
+    // Values below kSubBuckets are stored exactly, every power of two above that is divided into
+    // kSubBuckets / 2 linear buckets
+    static const int kSubBucketBits = 7;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kHalfSubBuckets = kSubBuckets / 2;
+    static const int kMaxValueBits = 36;
+    static const int kNumCounts = (kMaxValueBits - kSubBucketBits + 2) * kHalfSubBuckets;
+    
+    static inline int IndexOf(uint64_t value)
+    {
+        const uint64_t maxValue = (uint64_t(1) << kMaxValueBits) - 1;
+        if (value > maxValue)
+            value = maxValue;
+        
+        int bucket = (63 - __builtin_clzll(value | (kSubBuckets - 1))) - (kSubBucketBits - 1);
+        return (bucket << (kSubBucketBits - 1)) + int(value >> bucket);
+    }
+    
+    // Highest value that maps to the given index
+    static uint64_t ValueOf(int index);
+private:
+    volatile uint32_t counts_[kNumCounts];
+    volatile uint64_t total_;
+    volatile uint64_t max_;
+};
+
+#endif // _INCLUDE_SRCDS_HDRHISTOGRAM_H_
@@ -0,0 +1,545 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "KeyValuesFile.h"
+#include "platform.h"
+
+KeyValuesFile::KeyValuesFile()
+    : map_(nullptr), mapLength_(0), end_(nullptr), nodes_(nullptr), nodeCount_(0), nodeCapacity_(0),
+      firstTop_(-1), error_(false), errorOffset_(0)
+{
+
+}
+
+KeyValuesFile::~KeyValuesFile()
+{
+    Close();
+    free(nodes_);
+}
+
+bool KeyValuesFile::Open(const char *path)
+{
+    Close();
+    
+    int fd = open(path, O_RDONLY);
+    
+    if (fd == -1)
+        return false;
+    
+    struct stat st;
+    
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    
+    if (st.st_size > 0)
+    {
+        map_ = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        
+        if (map_ == MAP_FAILED)
+        {
+            map_ = nullptr;
+            close(fd);
+            return false;
+        }
+        
+        mapLength_ = st.st_size;
+    }
+    
+    // The mapping stays valid without the descriptor
+    close(fd);
+    
+    // A syntax error only loses what comes after it (see HasError)
+    Parse((const char *)map_, mapLength_);
+    return true;
+}
+
+void KeyValuesFile::Close()
+{
+    if (map_)
+    {
+        munmap(map_, mapLength_);
+        map_ = nullptr;
+        mapLength_ = 0;
+    }
+    
+    nodeCount_ = 0;
+    firstTop_ = -1;
+    error_ = false;
+    errorOffset_ = 0;
+}
+
+bool KeyValuesFile::Parse(const char *text, size_t length)
+{
+    struct frame_t
+    {
+        int32_t node;           // Block being parsed, -1 at the top level
+        int32_t lastChild;
+        bool keep;              // Whether the conditional before the block held
+    };
+    
+    frame_t stack[KV_MAX_DEPTH + 1];
+    int depth = 0;
+    
+    stack[0].node = -1;
+    stack[0].lastChild = -1;
+    stack[0].keep = true;
+    
+    nodeCount_ = 0;
+    firstTop_ = -1;
+    error_ = false;
+    errorOffset_ = 0;
+    
+    if (!text)
+        text = "";
+    
+    const char *start = text;
+    end_ = text + length;
+    
+    // Skip the UTF-8 byte order mark that some editors add
+    if (length >= 3 && memcmp(text, "\xEF\xBB\xBF", 3) == 0)
+        text += 3;
+    
+    // Most files have about one key for every few dozen bytes
+    if (nodeCapacity_ < length / 32)
+    {
+        kv_node_t *nodes = (kv_node_t *)realloc(nodes_, sizeof(kv_node_t) * (length / 32));
+        
+        if (nodes)
+        {
+            nodes_ = nodes;
+            nodeCapacity_ = length / 32;
+        }
+    }
+    
+    // Adds a finished node to the block being parsed
+    auto link = [this, &stack, &depth](int32_t node) {
+        frame_t &parent = stack[depth];
+        
+        if (parent.lastChild != -1)
+            nodes_[parent.lastChild].nextSibling = node;
+        else if (parent.node != -1)
+            nodes_[parent.node].firstChild = node;
+        else
+            firstTop_ = node;
+        
+        parent.lastChild = node;
+    };
+    
+    const char *pos = text;
+    token_t token;
+    bool haveToken = false;
+    
+    for (;;)
+    {
+        if (!haveToken)
+            pos = NextToken(pos, token);
+        
+        haveToken = false;
+        
+        int32_t done;
+        bool keep;
+        
+        if (token.type == Token_End)
+        {
+            break;
+        }
+        else if (token.type == Token_CloseBrace)
+        {
+            if (depth == 0)
+            {
+                error_ = true;
+                break;
+            }
+            
+            done = stack[depth].node;
+            keep = stack[depth].keep;
+            depth--;
+        }
+        else if (token.type == Token_String)
+        {
+            token_t key = token;
+            keep = true;
+            pos = NextToken(pos, token);
+            
+            // A conditional can also come between a key and its block
+            if (token.type == Token_Condition)
+            {
+                keep = EvaluateCondition(token.start, token.length);
+                pos = NextToken(pos, token);
+            }
+            
+            if (token.type == Token_OpenBrace)
+            {
+                if (depth == KV_MAX_DEPTH || (done = AddNode(key)) == -1)
+                {
+                    error_ = true;
+                    break;
+                }
+                
+                depth++;
+                stack[depth].node = done;
+                stack[depth].lastChild = -1;
+                stack[depth].keep = keep;
+                continue;
+            }
+            
+            if (token.type != Token_String || (done = AddNode(key)) == -1)
+            {
+                error_ = true;
+                break;
+            }
+            
+            kv_node_t &node = nodes_[done];
+            node.value = token.start;
+            node.valueLength = uint32_t(token.length);
+            node.valueEscaped = token.escaped;
+        }
+        else
+        {
+            error_ = true;
+            break;
+        }
+        
+        // A conditional after a value or block decides whether it is kept
+        pos = NextToken(pos, token);
+        
+        if (token.type == Token_Condition)
+            keep = keep && EvaluateCondition(token.start, token.length);
+        else
+            haveToken = true;
+        
+        // Everything after the node belongs to it, so this drops the whole block
+        if (!keep)
+        {
+            nodeCount_ = done;
+            continue;
+        }
+        
+        link(done);
+    }
+    
+    // A block that isn't closed is an error, but still keeps the keys it got so far
+    if (depth > 0)
+        error_ = true;
+    
+    if (error_)
+        errorOffset_ = size_t(token.start - start);
+    
+    while (depth > 0)
+    {
+        int32_t node = stack[depth].node;
+        bool keep = stack[depth].keep;
+        depth--;
+        
+        if (keep)
+            link(node);
+        else
+            nodeCount_ = node;
+    }
+    
+    return !error_;
+}
+
+bool KeyValuesFile::HasError() const
+{
+    return error_;
+}
+
+size_t KeyValuesFile::GetErrorOffset() const
+{
+    return errorOffset_;
+}
+
+const char *KeyValuesFile::NextToken(const char *pos, token_t &token) const
+{
+    // Skip whitespace and comments
+    for (;;)
+    {
+        while (pos < end_ && (unsigned char)*pos <= ' ')
+            pos++;
+        
+        if (pos + 1 >= end_ || pos[0] != '/' || pos[1] != '/')
+            break;
+        
+        pos = (const char *)memchr(pos, '\n', end_ - pos);
+        
+        if (!pos)
+            pos = end_;
+    }
+    
+    token.start = pos;
+    token.length = 0;
+    token.escaped = false;
+    
+    if (pos >= end_)
+    {
+        token.type = Token_End;
+        return pos;
+    }
+    
+    switch (*pos)
+    {
+        case '{':
+            token.type = Token_OpenBrace;
+            return pos + 1;
+        case '}':
+            token.type = Token_CloseBrace;
+            return pos + 1;
+        case '"':
+        {
+            token.start = ++pos;
+            
+            while (pos < end_ && *pos != '"')
+            {
+                if (*pos == '\\' && pos + 1 < end_)
+                {
+                    token.escaped = true;
+                    pos++;
+                }
+                
+                pos++;
+            }
+            
+            if (pos >= end_)
+            {
+                token.type = Token_Invalid;
+                return pos;
+            }
+            
+            token.type = Token_String;
+            token.length = pos - token.start;
+            return pos + 1;
+        }
+        case '[':
+        {
+            const char *close = (const char *)memchr(pos, ']', end_ - pos);
+            
+            if (!close)
+            {
+                token.type = Token_Invalid;
+                return end_;
+            }
+            
+            token.type = Token_Condition;
+            token.start = pos + 1;
+            token.length = close - token.start;
+            return close + 1;
+        }
+    }
+    
+    // Unquoted strings end at whitespace, quotes and braces
+    while (pos < end_ && (unsigned char)*pos > ' ' && *pos != '"' && *pos != '{' && *pos != '}')
+        pos++;
+    
+    token.type = Token_String;
+    token.length = pos - token.start;
+    return pos;
+}
+
+int32_t KeyValuesFile::AddNode(const token_t &key)
+{
+    if (nodeCount_ == nodeCapacity_)
+    {
+        size_t capacity = nodeCapacity_ ? nodeCapacity_ * 2 : 64;
+        
+        // Nodes refer to each other with 32-bit indexes
+        if (capacity > 0x7FFFFFFF)
+            return -1;
+        
+        kv_node_t *nodes = (kv_node_t *)realloc(nodes_, sizeof(kv_node_t) * capacity);
+        
+        if (!nodes)
+            return -1;
+        
+        nodes_ = nodes;
+        nodeCapacity_ = capacity;
+    }
+    
+    kv_node_t &node = nodes_[nodeCount_];
+    node.key = key.start;
+    node.keyLength = uint32_t(key.length);
+    node.keyEscaped = key.escaped;
+    node.value = nullptr;
+    node.valueLength = 0;
+    node.valueEscaped = false;
+    node.firstChild = -1;
+    node.nextSibling = -1;
+    
+    return int32_t(nodeCount_++);
+}
+
+// Conditionals are names like $WIN32 combined with !, && and ||
+bool KeyValuesFile::EvaluateCondition(const char *start, size_t length)
+{
+    const char *pos = start;
+    const char *end = start + length;
+    bool result = false;
+    bool group = true;
+    
+    while (pos < end)
+    {
+        if (*pos == '|')
+        {
+            result = result || group;
+            group = true;
+            pos += (pos + 1 < end && pos[1] == '|') ? 2 : 1;
+            continue;
+        }
+        
+        if (*pos != '!' && *pos != '$')
+        {
+            pos++;
+            continue;
+        }
+        
+        bool negate = false;
+        
+        while (pos < end && *pos == '!')
+        {
+            negate = !negate;
+            pos++;
+        }
+        
+        if (pos < end && *pos == '$')
+            pos++;
+        
+        const char *name = pos;
+        
+        while (pos < end && (isalnum((unsigned char)*pos) || *pos == '_'))
+            pos++;
+        
+        size_t nameLength = pos - name;
+        bool value;
+        
+#if defined(PLATFORM_MACOSX)
+        value = (nameLength == 3 && strncasecmp(name, "OSX", 3) == 0) ||
+                (nameLength == 5 && strncasecmp(name, "POSIX", 5) == 0);
+#elif defined(PLATFORM_LINUX)
+        value = (nameLength == 5 && strncasecmp(name, "LINUX", 5) == 0) ||
+                (nameLength == 5 && strncasecmp(name, "POSIX", 5) == 0);
+#else
+        value = (nameLength == 5 && strncasecmp(name, "WIN32", 5) == 0) ||
+                (nameLength == 7 && strncasecmp(name, "WINDOWS", 7) == 0);
+#endif
+        
+        group = group && (value != negate);
+    }
+    
+    return result || group;
+}
+
+const kv_node_t *KeyValuesFile::GetFirstChild(const kv_node_t *node) const
+{
+    int32_t index = node ? node->firstChild : firstTop_;
+    
+    return index != -1 ? &nodes_[index] : nullptr;
+}
+
+const kv_node_t *KeyValuesFile::GetNextSibling(const kv_node_t *node) const
+{
+    return node->nextSibling != -1 ? &nodes_[node->nextSibling] : nullptr;
+}
+
+const kv_node_t *KeyValuesFile::FindChild(const kv_node_t *node, const char *key) const
+{
+    size_t length = strlen(key);
+    
+    for (const kv_node_t *child = GetFirstChild(node); child; child = GetNextSibling(child))
+    {
+        if (child->keyLength == length && strncasecmp(child->key, key, length) == 0)
+            return child;
+    }
+    
+    return nullptr;
+}
+
+AString KeyValuesFile::GetKey(const kv_node_t *node)
+{
+    return Unescape(node->key, node->keyLength, node->keyEscaped);
+}
+
+AString KeyValuesFile::GetValue(const kv_node_t *node)
+{
+    if (!node->value)
+        return AString();
+    
+    return Unescape(node->value, node->valueLength, node->valueEscaped);
+}
+
+AString KeyValuesFile::Unescape(const char *start, size_t length, bool escaped)
+{
+    if (!escaped)
+        return AString(start, length);
+    
+    char *buffer = (char *)malloc(length);
+    size_t out = 0;
+    
+    for (size_t i = 0; i < length; i++)
+    {
+        if (start[i] != '\\' || i + 1 == length)
+        {
+            buffer[out++] = start[i];
+            continue;
+        }
+        
+        switch (start[++i])
+        {
+            case 'n':
+                buffer[out++] = '\n';
+                break;
+            case 't':
+                buffer[out++] = '\t';
+                break;
+            case '\\':
+            case '"':
+                buffer[out++] = start[i];
+                break;
+            default:
+                // Anything else is most likely a Windows path
+                buffer[out++] = '\\';
+                buffer[out++] = start[i];
+                break;
+        }
+    }
+    
+    AString result(buffer, out);
+    free(buffer);
+    
+    return result;
+}
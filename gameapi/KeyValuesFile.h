@@ -0,0 +1,127 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_KEYVALUESFILE_H_
+#define _INCLUDE_SRCDS_KEYVALUESFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "am-string.h"
+
+using namespace ke;
+
+// Blocks nested deeper than this are a parse error
+#define KV_MAX_DEPTH 64
+
+// A key with either a value or a block of child keys. Keys and values point into the parsed
+// buffer and aren't NUL-terminated; GetKey and GetValue turn them into strings.
+struct kv_node_t
+{
+    const char *key;
+    const char *value;          // nullptr for a block
+    uint32_t keyLength;
+    uint32_t valueLength;
+    int32_t firstChild;         // Index of the first key in a block, -1 if there isn't one
+    int32_t nextSibling;        // Index of the next key in the same block, -1 at the end
+    bool keyEscaped;            // Contains escape sequences
+    bool valueEscaped;
+};
+
+// Reader for Valve's KeyValues text format (gameinfo.txt, .res, .vdf). The file is mapped into
+// memory and tokenized in a single pass into a flat array of nodes that refer to the mapped text,
+// so nothing is copied while parsing. Quoted and unquoted strings, escape sequences, // comments
+// and nested blocks are supported. Keys and blocks with a conditional ([$WIN32], [!$X360 && $OSX],
+// etc.) are only kept if it holds for the platform this is running on.
+class KeyValuesFile
+{
+public:
+    KeyValuesFile();
+    ~KeyValuesFile();
+    
+    // Maps and parses a file. Returns false if it can't be read. A syntax error doesn't make this
+    // fail; the keys before it are kept and HasError says so.
+    bool Open(const char *path);
+    
+    // Parses text that stays valid for as long as the nodes are used. Returns false on a syntax
+    // error, in which case the keys up to the error are still available.
+    bool Parse(const char *text, size_t length);
+    
+    void Close();
+    
+    // Whether the last parse stopped early because of a syntax error, and where in the text
+    bool HasError() const;
+    size_t GetErrorOffset() const;
+    
+    // Returns the first key in a block, or the first top-level key if node is null
+    const kv_node_t *GetFirstChild(const kv_node_t *node) const;
+    const kv_node_t *GetNextSibling(const kv_node_t *node) const;
+    
+    // Returns the first key with the given name in a block (or at the top level if node is null),
+    // ignoring case
+    const kv_node_t *FindChild(const kv_node_t *node, const char *key) const;
+    
+    static AString GetKey(const kv_node_t *node);
+    static AString GetValue(const kv_node_t *node);
+private:
+    enum TokenType
+    {
+        Token_End,
+        Token_String,
+        Token_OpenBrace,
+        Token_CloseBrace,
+        Token_Condition,
+        Token_Invalid
+    };
+    
+    struct token_t
+    {
+        TokenType type;
+        const char *start;
+        size_t length;
+        bool escaped;
+    };
+    
+    const char *NextToken(const char *pos, token_t &token) const;
+    const char *SkipCondition(const char *pos, bool &keep) const;
+    int32_t AddNode(const token_t &key);
+    static bool EvaluateCondition(const char *start, size_t length);
+    static AString Unescape(const char *start, size_t length, bool escaped);
+private:
+    void *map_;
+    size_t mapLength_;
+    const char *end_;
+    
+    kv_node_t *nodes_;
+    size_t nodeCount_;
+    size_t nodeCapacity_;
+    int32_t firstTop_;
+    bool error_;
+    size_t errorOffset_;
+};
+
+#endif // _INCLUDE_SRCDS_KEYVALUESFILE_H_
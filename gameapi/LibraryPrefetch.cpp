@@ -0,0 +1,208 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "LibraryPrefetch.h"
+#include "StartupTrace.h"
+#include "platform.h"
+
+#if defined(PLATFORM_MACOSX)
+#define LIBEXT ".dylib"
+#define LIBPATH_ENV "DYLD_LIBRARY_PATH"
+#else
+#define LIBEXT ".so"
+#define LIBPATH_ENV "LD_LIBRARY_PATH"
+#endif
+
+LibraryPrefetcher::LibraryPrefetcher(ErrorReporter *reporter)
+    : reporter_(reporter), enabled_(false), files_(nullptr), fileCount_(0), nextFile_(0),
+      threadCount_(0)
+{
+
+}
+
+LibraryPrefetcher::~LibraryPrefetcher()
+{
+    Stop();
+}
+
+void LibraryPrefetcher::ParseOptions(int argc, char *argv[])
+{
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-prefetch") == 0)
+            enabled_ = true;
+    }
+}
+
+void LibraryPrefetcher::Start(const char *gameDir)
+{
+    if (!enabled_ || files_)
+        return;
+    
+    files_ = new AString[PREFETCH_MAX_FILES];
+    fileCount_ = 0;
+    nextFile_ = 0;
+    
+    LinkedList<AString> added;
+    
+    // Engine libraries first, since they are loaded first
+    AddDirectory("bin", added);
+    
+    const char *env = getenv(LIBPATH_ENV);
+    
+    while (env && *env)
+    {
+        const char *end = strchr(env, ':');
+        size_t len = end ? size_t(end - env) : strlen(env);
+        
+        if (len)
+        {
+            AString dir(env, len);
+            AddDirectory(dir.chars(), added);
+        }
+        
+        env = end ? end + 1 : nullptr;
+    }
+    
+    if (gameDir && gameDir[0])
+    {
+        AString dir(gameDir);
+        dir.append("/bin");
+        AddDirectory(dir.chars(), added);
+    }
+    
+    if (!fileCount_)
+        return;
+    
+    for (int i = 0; i < PREFETCH_THREADS && uint32_t(i) < fileCount_; i++)
+    {
+        if (pthread_create(&threads_[threadCount_], nullptr, ThreadMain, this) != 0)
+            break;
+        
+        threadCount_++;
+    }
+    
+    if (!threadCount_)
+        reporter_->Warning("Failed to start library prefetch threads.\n");
+}
+
+void LibraryPrefetcher::Stop()
+{
+    for (int i = 0; i < threadCount_; i++)
+        pthread_join(threads_[i], nullptr);
+    
+    threadCount_ = 0;
+    
+    delete [] files_;
+    files_ = nullptr;
+    fileCount_ = 0;
+}
+
+void LibraryPrefetcher::AddDirectory(const char *dir, LinkedList<AString> &added)
+{
+    char resolved[PATH_MAX];
+    
+    if (!realpath(dir, resolved))
+        return;
+    
+    // The library path often has bin in it already
+    for (AString &i : added)
+    {
+        if (i.compare(resolved) == 0)
+            return;
+    }
+    
+    added.append(AString(resolved));
+    
+    DIR *dp = opendir(dir);
+    
+    if (!dp)
+        return;
+    
+    struct dirent *ent;
+    
+    while ((ent = readdir(dp)) != nullptr && fileCount_ < PREFETCH_MAX_FILES)
+    {
+        if (!strstr(ent->d_name, LIBEXT))
+            continue;
+        
+        AString &path = files_[fileCount_++];
+        path = dir;
+        path.append("/");
+        path.append(ent->d_name);
+    }
+    
+    closedir(dp);
+}
+
+void *LibraryPrefetcher::ThreadMain(void *param)
+{
+    static_cast<LibraryPrefetcher *>(param)->Run();
+    return nullptr;
+}
+
+void LibraryPrefetcher::Run()
+{
+    uint32_t index;
+    
+    while ((index = __sync_fetch_and_add(&nextFile_, 1)) < fileCount_)
+        Prefetch(files_[index].chars());
+}
+
+void LibraryPrefetcher::Prefetch(const char *path)
+{
+    TRACE_SCOPE("Prefetch", path);
+    
+    int fd = open(path, O_RDONLY);
+    
+    if (fd == -1)
+        return;
+    
+    struct stat st;
+    
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+#if defined(PLATFORM_MACOSX)
+        struct radvisory advice;
+        advice.ra_offset = 0;
+        advice.ra_count = st.st_size < INT_MAX ? int(st.st_size) : INT_MAX;
+        fcntl(fd, F_RDADVISE, &advice);
+#else
+        posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+#endif
+    }
+    
+    close(fd);
+}
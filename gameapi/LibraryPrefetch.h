@@ -0,0 +1,81 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_LIBRARYPREFETCH_H_
+#define _INCLUDE_SRCDS_LIBRARYPREFETCH_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include "am-string.h"
+#include "am-linkedlist.h"
+#include "ErrorReporter.h"
+
+using namespace ke;
+
+// Number of threads that issue read-ahead requests
+#define PREFETCH_THREADS 4
+
+// Most libraries that are prefetched
+#define PREFETCH_MAX_FILES 256
+
+// Warms the page cache with the game and engine libraries before they are loaded. On a cold
+// start, reading libraries one at a time as each dlopen() needs them dominates boot time, so the
+// libraries in bin, <game>/bin and the library path are handed to a few threads that ask the
+// kernel to read them ahead. Each directory is only read once, even if it is on the library path
+// as well. Turned on with -prefetch.
+class LibraryPrefetcher
+{
+public:
+    LibraryPrefetcher(ErrorReporter *reporter);
+    ~LibraryPrefetcher();
+    
+    void ParseOptions(int argc, char *argv[]);
+    
+    // Starts prefetching the libraries for the given game directory in the background
+    void Start(const char *gameDir);
+    
+    // Waits for the prefetch threads to finish
+    void Stop();
+private:
+    void AddDirectory(const char *dir, LinkedList<AString> &added);
+    static void *ThreadMain(void *param);
+    void Run();
+    static void Prefetch(const char *path);
+private:
+    ErrorReporter *reporter_;
+    bool enabled_;
+    
+    AString *files_;
+    uint32_t fileCount_;
+    volatile uint32_t nextFile_;
+    
+    pthread_t threads_[PREFETCH_THREADS];
+    int threadCount_;
+};
+
+#endif // _INCLUDE_SRCDS_LIBRARYPREFETCH_H_
@@ -0,0 +1,434 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include "LogSink.h"
+#include "Clock.h"
+#include "stringutil.h"
+
+// Keeps the compiler from moving memory accesses across this point. x86 doesn't reorder stores
+// with other stores or loads with other loads, so that's enough to hand blocks between threads.
+#define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+// How long output can sit in a block before it gets written
+static const uint64_t kFlushNanos = 200000000;
+
+LogSink::LogSink(ErrorReporter *reporter)
+    : reporter_(reporter),
+      maxFileSize_(0),
+      maxFileAge_(0),
+      sync_(Sync_Rotate),
+      fill_(0),
+      handOffs_(0),
+      running_(false),
+      fd_(-1),
+      fileSize_(0),
+      fileOpened_(0),
+      bytesWritten_(0),
+      bytesDropped_(0),
+      writeErrors_(0),
+      rotations_(0)
+{
+    path_[0] = '\0';
+    memset(blocks_, 0, sizeof(blocks_));
+    
+    pthread_mutex_init(&mutex_, nullptr);
+    pthread_cond_init(&cond_, nullptr);
+}
+
+LogSink::~LogSink()
+{
+    Stop();
+    
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+void LogSink::ParseOptions(int argc, char *argv[])
+{
+    for (int i = 0; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-consolelog") == 0)
+        {
+            strncopy(path_, argv[++i], sizeof(path_));
+        }
+        else if (strcmp(argv[i], "-consolelogsize") == 0)
+        {
+            maxFileSize_ = uint64_t(atoi(argv[++i])) * 1024 * 1024;
+        }
+        else if (strcmp(argv[i], "-consolelogrotate") == 0)
+        {
+            maxFileAge_ = time_t(atoi(argv[++i])) * 60;
+        }
+        else if (strcmp(argv[i], "-consolelogsync") == 0)
+        {
+            const char *policy = argv[++i];
+            
+            if (strcmp(policy, "never") == 0)
+                sync_ = Sync_Never;
+            else if (strcmp(policy, "always") == 0)
+                sync_ = Sync_Always;
+            else
+                sync_ = Sync_Rotate;
+        }
+    }
+}
+
+bool LogSink::IsEnabled() const
+{
+    return path_[0] != '\0';
+}
+
+bool LogSink::Start()
+{
+    if (!IsEnabled() || running_)
+        return running_;
+    
+    for (int i = 0; i < 2; i++)
+    {
+        if (!blocks_[i].data && (blocks_[i].data = (char *)malloc(kBlockSize)) == nullptr)
+        {
+            reporter_->Warning("Failed to allocate console log buffers.\n");
+            return false;
+        }
+    }
+    
+    if (!OpenFile())
+    {
+        reporter_->Warning("Failed to open console log %s: %s\n", path_, strerror(errno));
+        return false;
+    }
+    
+    running_ = true;
+    
+    if (pthread_create(&thread_, nullptr, ThreadMain, this) != 0)
+    {
+        reporter_->Warning("Failed to start console log writer thread.\n");
+        running_ = false;
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    
+    return true;
+}
+
+void LogSink::Stop()
+{
+    if (!running_)
+        return;
+    
+    running_ = false;
+    pthread_cond_signal(&cond_);
+    pthread_join(thread_, nullptr);
+    
+    // The engine thread is done writing, so the block it was filling can go out as well
+    if (blocks_[fill_].length > 0)
+    {
+        Block *block = &blocks_[fill_];
+        WriteBlocks(&block, 1);
+    }
+    
+    if (fd_ != -1)
+    {
+        if (sync_ != Sync_Never)
+            fsync(fd_);
+        
+        close(fd_);
+        fd_ = -1;
+    }
+    
+    for (int i = 0; i < 2; i++)
+    {
+        free(blocks_[i].data);
+        blocks_[i].data = nullptr;
+    }
+}
+
+void LogSink::Write(const char *text)
+{
+    if (!running_)
+        return;
+    
+    size_t len = strlen(text);
+    
+    // The writer thread only takes this to swap blocks, so it's hardly ever contended
+    pthread_mutex_lock(&mutex_);
+    
+    Block *block = &blocks_[fill_];
+    
+    // Hand the block over if this doesn't fit or it has been waiting long enough
+    if (block->length > 0 && (block->length + len > kBlockSize ||
+                              ClockNanos() - block->firstWrite >= kFlushNanos))
+    {
+        if (HandOff())
+            block = &blocks_[fill_];
+    }
+    
+    if (block->length + len > kBlockSize)
+    {
+        // The writer thread is still busy with the other block
+        __sync_fetch_and_add(&bytesDropped_, len);
+    }
+    else
+    {
+        if (block->length == 0)
+            block->firstWrite = ClockNanos();
+        
+        memcpy(&block->data[block->length], text, len);
+        block->length += len;
+    }
+    
+    pthread_mutex_unlock(&mutex_);
+}
+
+void LogSink::HandOffIfDue()
+{
+    const Block &block = blocks_[fill_];
+    
+    if (block.length > 0 && ClockNanos() - block.firstWrite >= kFlushNanos)
+        HandOff();
+}
+
+bool LogSink::HandOff()
+{
+    int other = fill_ ^ 1;
+    
+    if (blocks_[other].pending)
+        return false;
+    
+    blocks_[fill_].seq = ++handOffs_;
+    
+    COMPILER_BARRIER();
+    blocks_[fill_].pending = true;
+    fill_ = other;
+    
+    pthread_cond_signal(&cond_);
+    return true;
+}
+
+void LogSink::WritePending()
+{
+    Block *blocks[2];
+    int count = 0;
+    
+    for (int i = 0; i < 2; i++)
+    {
+        if (blocks_[i].pending)
+            blocks[count++] = &blocks_[i];
+    }
+    
+    if (count == 0)
+        return;
+    
+    COMPILER_BARRIER();
+    
+    // Write the older block first
+    if (count == 2 && int32_t(blocks[0]->seq - blocks[1]->seq) > 0)
+    {
+        Block *tmp = blocks[0];
+        blocks[0] = blocks[1];
+        blocks[1] = tmp;
+    }
+    
+    WriteBlocks(blocks, count);
+    
+    // Give the blocks back to the engine thread
+    for (int i = 0; i < count; i++)
+    {
+        blocks[i]->length = 0;
+        COMPILER_BARRIER();
+        blocks[i]->pending = false;
+    }
+}
+
+void LogSink::WriteBlocks(Block *blocks[], int count)
+{
+    struct iovec iov[2];
+    size_t total = 0;
+    
+    for (int i = 0; i < count; i++)
+    {
+        iov[i].iov_base = blocks[i]->data;
+        iov[i].iov_len = blocks[i]->length;
+        total += blocks[i]->length;
+    }
+    
+    if ((maxFileSize_ && fileSize_ >= maxFileSize_) ||
+        (maxFileAge_ && time(nullptr) - fileOpened_ >= maxFileAge_))
+    {
+        Rotate();
+    }
+    
+    if (fd_ == -1)
+    {
+        __sync_fetch_and_add(&bytesDropped_, total);
+        return;
+    }
+    
+    uint64_t start = ClockNanos();
+    
+    // Pick up where a short write left off
+    int first = 0;
+    size_t remaining = total;
+    
+    while (remaining > 0)
+    {
+        ssize_t written = writev(fd_, &iov[first], count - first);
+        
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            
+            writeErrors_++;
+            __sync_fetch_and_add(&bytesDropped_, remaining);
+            break;
+        }
+        
+        remaining -= written;
+        bytesWritten_ += written;
+        fileSize_ += written;
+        
+        while (first < count && size_t(written) >= iov[first].iov_len)
+            written -= iov[first++].iov_len;
+        
+        if (first < count)
+        {
+            iov[first].iov_base = (char *)iov[first].iov_base + written;
+            iov[first].iov_len -= written;
+        }
+    }
+    
+    if (sync_ == Sync_Always)
+        fsync(fd_);
+    
+    flushTimes_.Record(ClockNanos() - start);
+}
+
+bool LogSink::OpenFile()
+{
+    fd_ = open(path_, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    
+    if (fd_ == -1)
+        return false;
+    
+    struct stat st;
+    fileSize_ = (fstat(fd_, &st) == 0) ? st.st_size : 0;
+    fileOpened_ = time(nullptr);
+    
+    return true;
+}
+
+void LogSink::Rotate()
+{
+    char rotated[1100];
+    char stamp[32];
+    time_t now = time(nullptr);
+    
+    if (fd_ != -1)
+    {
+        if (sync_ != Sync_Never)
+            fsync(fd_);
+        
+        close(fd_);
+        fd_ = -1;
+    }
+    
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+    snprintf(rotated, sizeof(rotated), "%s.%s", path_, stamp);
+    
+    // Don't overwrite a file that was rotated within the same second
+    struct stat st;
+    for (unsigned int n = 1; stat(rotated, &st) == 0; n++)
+        snprintf(rotated, sizeof(rotated), "%s.%s.%u", path_, stamp, n);
+    
+    if (rename(path_, rotated) != 0)
+        writeErrors_++;
+    
+    if (!OpenFile())
+        writeErrors_++;
+    
+    rotations_++;
+}
+
+void LogSink::WaitForWork()
+{
+    struct timeval now;
+    struct timespec timeout;
+    
+    gettimeofday(&now, nullptr);
+    timeout.tv_sec = now.tv_sec;
+    timeout.tv_nsec = now.tv_usec * 1000 + long(kFlushNanos);
+    
+    while (timeout.tv_nsec >= 1000000000)
+    {
+        timeout.tv_sec++;
+        timeout.tv_nsec -= 1000000000;
+    }
+    
+    pthread_mutex_lock(&mutex_);
+    
+    if (running_ && !blocks_[0].pending && !blocks_[1].pending)
+        pthread_cond_timedwait(&cond_, &mutex_, &timeout);
+    
+    // Take output that has been waiting too long even if no more is coming to hand it over
+    HandOffIfDue();
+    
+    pthread_mutex_unlock(&mutex_);
+}
+
+void *LogSink::ThreadMain(void *param)
+{
+    LogSink *sink = (LogSink *)param;
+    
+    while (sink->running_)
+    {
+        sink->WaitForWork();
+        sink->WritePending();
+    }
+    
+    sink->WritePending();
+    return nullptr;
+}
+
+void LogSink::GetStats(log_stats_t *stats) const
+{
+    stats->bytesWritten = bytesWritten_;
+    stats->bytesDropped = bytesDropped_;
+    stats->writeErrors = writeErrors_;
+    stats->rotations = rotations_;
+    flushTimes_.Snapshot(&stats->flushLatency);
+}
@@ -0,0 +1,132 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_LOGSINK_H_
+#define _INCLUDE_SRCDS_LOGSINK_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "IGameAPI.h"
+#include "ErrorReporter.h"
+#include "HdrHistogram.h"
+
+// Writes console output to a file without doing any I/O on the engine thread. The engine thread
+// copies output into one of two 1 MB blocks and hands a block over to a background thread once it
+// is full. The background thread takes the block itself once output has been waiting in it for
+// 200 ms, so a quiet server's log still gets written. Blocks are swapped under a mutex that is never
+// held during I/O. The background thread writes both blocks with a single writev if it has fallen
+// behind. If the disk stalls for so long that both blocks fill up, output is dropped (and counted)
+// rather than holding up the server.
+//
+// Command line options:
+//
+//   -consolelog <file>         Enables the log
+//   -consolelogsize <MB>       Starts a new file once the current one reaches this size
+//   -consolelogrotate <min>    Starts a new file after this many minutes
+//   -consolelogsync <policy>   When to fsync: "never", "rotate" (default) or "always"
+//
+// Old files are renamed to <file>.<date>-<time>, with a .<n> suffix if that name is already taken.
+class LogSink
+{
+public:
+    LogSink(ErrorReporter *reporter);
+    ~LogSink();
+    
+    void ParseOptions(int argc, char *argv[]);
+    bool IsEnabled() const;
+    
+    // Opens the log file and starts the writer thread
+    bool Start();
+    
+    // Writes out everything that is left and stops the writer thread
+    void Stop();
+    
+    // Adds console output. Only to be called from the engine thread.
+    void Write(const char *text);
+    
+    void GetStats(log_stats_t *stats) const;
+private:
+    enum SyncPolicy
+    {
+        Sync_Never,
+        Sync_Rotate,
+        Sync_Always
+    };
+    
+    struct Block
+    {
+        char *data;
+        size_t length;
+        uint64_t firstWrite;    // When the oldest output in the block was added
+        uint32_t seq;           // Order in which blocks were handed over
+        volatile bool pending;  // Owned by the writer thread until it has been written
+    };
+    
+    // Both require mutex_ to be held
+    bool HandOff();
+    void HandOffIfDue();
+    void WritePending();
+    void WriteBlocks(Block *blocks[], int count);
+    bool OpenFile();
+    void Rotate();
+    void WaitForWork();
+    
+    static void *ThreadMain(void *param);
+private:
+    static const size_t kBlockSize = 1024 * 1024;
+    
+    ErrorReporter *reporter_;
+    char path_[1024];
+    uint64_t maxFileSize_;
+    time_t maxFileAge_;
+    SyncPolicy sync_;
+    
+    // Guarded by mutex_, except for the contents of blocks owned by the writer thread
+    Block blocks_[2];
+    int fill_;                  // Block the engine thread is writing to
+    uint32_t handOffs_;
+    
+    volatile bool running_;
+    pthread_t thread_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t cond_;
+    
+    // Only used by the writer thread
+    int fd_;
+    uint64_t fileSize_;
+    time_t fileOpened_;
+    
+    volatile uint64_t bytesWritten_;
+    volatile uint64_t bytesDropped_;
+    volatile uint64_t writeErrors_;
+    volatile uint32_t rotations_;
+    HdrHistogram flushTimes_;
+};
+
+#endif // _INCLUDE_SRCDS_LOGSINK_H_
@@ -0,0 +1,485 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "MapCatalog.h"
+#include "DirScan.h"
+#include "CacheDir.h"
+#include "platform.h"
+
+#define MAP_CATALOG_FILE SRCDS_CACHE_DIR "/map_catalog"
+#define MAP_CATALOG_MAGIC "SRCDSMC1"
+
+// How deep to look into subdirectories of a maps directory (i.e. maps/workshop/<id>)
+#define MAP_CATALOG_MAX_DEPTH 4
+
+// Entity lumps larger than this aren't summarized
+#define MAX_ENTITY_LUMP (32 * 1024 * 1024)
+
+#define BSP_IDENT (('P' << 24) + ('S' << 16) + ('B' << 8) + 'V')
+#define BSP_ENTITY_LUMP 0
+
+struct bsp_lump_t
+{
+    int32_t fileofs;
+    int32_t filelen;
+    int32_t version;
+    int32_t uncompressedSize;   // Only set if the lump is compressed
+};
+
+struct bsp_header_t
+{
+    int32_t ident;
+    int32_t version;
+    bsp_lump_t lumps[MAP_LUMP_COUNT];
+    int32_t mapRevision;
+};
+
+// Fixed part of a map in the catalog file, followed by the path
+struct catalog_record_t
+{
+    int64_t fileSize;
+    int64_t modTime;
+    int32_t version;
+    int32_t revision;
+    int32_t entityCount;
+    int32_t spawnPoints;
+    uint32_t lumpSizes[MAP_LUMP_COUNT];
+    uint32_t pathLength;
+};
+
+static int CompareMapNames(const void *a, const void *b)
+{
+    const map_info_t *infoA = *(const map_info_t * const *)a;
+    const map_info_t *infoB = *(const map_info_t * const *)b;
+    
+    return strcmp(infoA->name.chars(), infoB->name.chars());
+}
+
+MapCatalog::MapCatalog()
+    : loaded_(false), modified_(false), pending_(nullptr), pendingCount_(0), pendingCapacity_(0)
+{
+
+}
+
+MapCatalog::~MapCatalog()
+{
+    free(pending_);
+}
+
+void MapCatalog::BuildCatalog(const char *gameDir, LinkedList<map_info_t> &mapList)
+{
+    if (!loaded_)
+    {
+        index_.Initialize();
+        Load();
+        loaded_ = true;
+    }
+    
+    AString mapsDir(gameDir);
+    mapsDir.append(PLATFORM_SEP "maps");
+    
+    AString prefix(mapsDir);
+    prefix.append(PLATFORM_SEP);
+    
+    for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); iter++)
+    {
+        if (strncmp(iter->path.chars(), prefix.chars(), prefix.length()) == 0)
+            iter->seen = false;
+    }
+    
+    ScanDirectory(mapsDir.chars(), "", 0);
+    
+    // Reading the headers of new maps is where a large maps directory spends its time
+    ParallelFor(pendingCount_, ReadPendingMap, pending_);
+    pendingCount_ = 0;
+    
+    // Gather the maps that are still there so they can be sorted
+    size_t count = 0;
+    size_t capacity = 64;
+    map_info_t **maps = (map_info_t **)malloc(sizeof(map_info_t *) * capacity);
+    
+    for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); iter++)
+    {
+        if (strncmp(iter->path.chars(), prefix.chars(), prefix.length()) != 0)
+            continue;
+        
+        if (!iter->seen)
+        {
+            if (iter->present)
+            {
+                iter->present = false;
+                modified_ = true;
+            }
+            
+            continue;
+        }
+        
+        if (count == capacity)
+        {
+            capacity *= 2;
+            maps = (map_info_t **)realloc(maps, sizeof(map_info_t *) * capacity);
+        }
+        
+        maps[count++] = &iter->info;
+    }
+    
+    qsort(maps, count, sizeof(map_info_t *), CompareMapNames);
+    
+    for (size_t i = 0; i < count; i++)
+        mapList.append(*maps[i]);
+    
+    free(maps);
+    
+    if (modified_)
+        Save();
+}
+
+void MapCatalog::ScanDirectory(const char *dir, const char *namePrefix, int depth)
+{
+    DirReader reader;
+    
+    if (!reader.Open(dir))
+        return;
+    
+    const char *name;
+    unsigned char type;
+    
+    while ((name = reader.Next(&type)) != nullptr)
+    {
+        if (name[0] == '.')
+            continue;
+        
+        AString path(dir);
+        path.append(PLATFORM_SEP);
+        path.append(name);
+        
+        struct stat st;
+        
+        if (stat(path.chars(), &st) != 0)
+            continue;
+        
+        if (S_ISDIR(st.st_mode))
+        {
+            if (depth < MAP_CATALOG_MAX_DEPTH)
+            {
+                AString subPrefix(namePrefix);
+                subPrefix.append(name);
+                subPrefix.append("/");
+                
+                ScanDirectory(path.chars(), subPrefix.chars(), depth + 1);
+            }
+            
+            continue;
+        }
+        
+        size_t length = strlen(name);
+        
+        if (!S_ISREG(st.st_mode) || length <= 4 || strcasecmp(name + length - 4, ".bsp") != 0)
+            continue;
+        
+        Entry *entry = AddEntry(path.chars());
+        entry->seen = true;
+        
+        // Only maps that are new or have changed have to be read
+        if (!entry->present || entry->info.fileSize != uint64_t(st.st_size) ||
+            entry->info.modTime != int64_t(st.st_mtime))
+        {
+            entry->info.fileSize = st.st_size;
+            entry->info.modTime = st.st_mtime;
+            entry->present = true;
+            
+            if (pendingCount_ == pendingCapacity_)
+            {
+                pendingCapacity_ = pendingCapacity_ ? pendingCapacity_ * 2 : 64;
+                pending_ = (Entry **)realloc(pending_, sizeof(Entry *) * pendingCapacity_);
+            }
+            
+            pending_[pendingCount_++] = entry;
+            modified_ = true;
+        }
+        
+        // Map names are the same on every platform
+        AString mapName(namePrefix);
+        mapName.append(name, length - 4);
+        entry->info.name = mapName;
+    }
+}
+
+void MapCatalog::ReadPendingMap(void *data, size_t index)
+{
+    Entry *entry = ((Entry **)data)[index];
+    
+    ReadMapInfo(entry->path.chars(), entry->info);
+}
+
+MapCatalog::Entry *MapCatalog::AddEntry(const char *path)
+{
+    size_t length = strlen(path);
+    Symbol *sym = index_.FindSymbol(path, length);
+    
+    if (sym)
+        return (Entry *)sym->address;
+    
+    Entry entry;
+    entry.path = path;
+    entry.info.fileSize = 0;
+    entry.info.modTime = 0;
+    entry.info.version = 0;
+    entry.info.revision = 0;
+    memset(entry.info.lumpSizes, 0, sizeof(entry.info.lumpSizes));
+    entry.info.entityCount = -1;
+    entry.info.spawnPoints = 0;
+    entry.present = false;
+    entry.seen = false;
+    
+    entries_.append(entry);
+    
+    Entry *added = &entries_.back();
+    index_.InternSymbol(path, length, added);
+    
+    return added;
+}
+
+bool MapCatalog::ReadMapInfo(const char *path, map_info_t &info)
+{
+    info.version = 0;
+    info.revision = 0;
+    memset(info.lumpSizes, 0, sizeof(info.lumpSizes));
+    info.entityCount = -1;
+    info.spawnPoints = 0;
+    
+    int fd = open(path, O_RDONLY);
+    
+    if (fd == -1)
+        return false;
+    
+    // The header holds the whole lump directory, so this is the only read most maps need
+    bsp_header_t header;
+    
+    if (pread(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header)) || header.ident != BSP_IDENT)
+    {
+        close(fd);
+        return false;
+    }
+    
+    // Left 4 Dead 2 moved the version to the start of each lump. Its offsets can't point inside
+    // the header, which is what tells the two apart.
+    bool versionFirst = header.version == 21 && header.lumps[0].fileofs < int32_t(sizeof(header));
+    
+    for (int i = 0; i < MAP_LUMP_COUNT; i++)
+    {
+        bsp_lump_t &lump = header.lumps[i];
+        
+        if (versionFirst)
+        {
+            int32_t offset = lump.filelen;
+            lump.filelen = lump.version;
+            lump.fileofs = offset;
+        }
+        
+        info.lumpSizes[i] = uint32_t(lump.filelen);
+    }
+    
+    info.version = header.version;
+    info.revision = header.mapRevision;
+    
+    // Compressed entity lumps aren't summarized
+    const bsp_lump_t &entities = header.lumps[BSP_ENTITY_LUMP];
+    
+    if (entities.uncompressedSize == 0 && entities.fileofs > 0 && entities.filelen > 0 &&
+        entities.filelen <= MAX_ENTITY_LUMP && uint64_t(entities.fileofs) + entities.filelen <= info.fileSize)
+    {
+        ReadEntitySummary(fd, entities.fileofs, entities.filelen, info);
+    }
+    
+    close(fd);
+    
+    return true;
+}
+
+void MapCatalog::ReadEntitySummary(int fd, off_t offset, size_t length, map_info_t &info)
+{
+    char *buffer = (char *)malloc(length);
+    
+    if (!buffer)
+        return;
+    
+    if (pread(fd, buffer, length, offset) != ssize_t(length))
+    {
+        free(buffer);
+        return;
+    }
+    
+    // The entity lump is a list of { "key" "value" ... } blocks
+    const char *pos = buffer;
+    const char *end = buffer + length;
+    int depth = 0;
+    int entityCount = 0;
+    int spawnPoints = 0;
+    bool isKey = true;
+    bool isClassname = false;
+    
+    for (; pos < end && *pos; pos++)
+    {
+        if (*pos == '{')
+        {
+            if (depth++ == 0)
+                entityCount++;
+            
+            isKey = true;
+        }
+        else if (*pos == '}')
+        {
+            if (depth > 0)
+                depth--;
+        }
+        else if (*pos == '"')
+        {
+            const char *token = ++pos;
+            
+            while (pos < end && *pos != '"')
+                pos++;
+            
+            if (pos == end)
+                break;
+            
+            size_t tokenLength = pos - token;
+            
+            if (isKey)
+                isClassname = tokenLength == 9 && memcmp(token, "classname", 9) == 0;
+            else if (isClassname && tokenLength > 12 && memcmp(token, "info_player_", 12) == 0)
+                spawnPoints++;
+            
+            isKey = !isKey;
+        }
+    }
+    
+    free(buffer);
+    
+    info.entityCount = entityCount;
+    info.spawnPoints = spawnPoints;
+}
+
+void MapCatalog::Load()
+{
+    FILE *fp = fopen(MAP_CATALOG_FILE, "rb");
+    
+    if (!fp)
+        return;
+    
+    // The records are only read back by the same build, but a different layout must not be
+    char magic[8];
+    uint32_t recordSize;
+    
+    if (fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, MAP_CATALOG_MAGIC, 8) != 0 ||
+        fread(&recordSize, sizeof(recordSize), 1, fp) != 1 || recordSize != sizeof(catalog_record_t))
+    {
+        fclose(fp);
+        return;
+    }
+    
+    catalog_record_t record;
+    char path[PATH_MAX];
+    
+    while (fread(&record, sizeof(record), 1, fp) == 1)
+    {
+        if (record.pathLength == 0 || record.pathLength >= sizeof(path) ||
+            fread(path, record.pathLength, 1, fp) != 1)
+        {
+            break;
+        }
+        
+        path[record.pathLength] = '\0';
+        
+        Entry *entry = AddEntry(path);
+        entry->info.fileSize = record.fileSize;
+        entry->info.modTime = record.modTime;
+        entry->info.version = record.version;
+        entry->info.revision = record.revision;
+        entry->info.entityCount = record.entityCount;
+        entry->info.spawnPoints = record.spawnPoints;
+        memcpy(entry->info.lumpSizes, record.lumpSizes, sizeof(record.lumpSizes));
+        
+        // It's checked against the file the next time its directory is scanned
+        entry->present = true;
+    }
+    
+    fclose(fp);
+}
+
+void MapCatalog::Save()
+{
+    if (!MakeCacheDir())
+        return;
+    
+    char tempPath[64];
+    snprintf(tempPath, sizeof(tempPath), MAP_CATALOG_FILE ".%d", (int)getpid());
+    
+    FILE *fp = fopen(tempPath, "wb");
+    
+    if (!fp)
+        return;
+    
+    uint32_t recordSize = sizeof(catalog_record_t);
+    
+    fwrite(MAP_CATALOG_MAGIC, 8, 1, fp);
+    fwrite(&recordSize, sizeof(recordSize), 1, fp);
+    
+    for (LinkedList<Entry>::iterator iter = entries_.begin(); iter != entries_.end(); iter++)
+    {
+        if (!iter->present)
+            continue;
+        
+        catalog_record_t record;
+        record.fileSize = iter->info.fileSize;
+        record.modTime = iter->info.modTime;
+        record.version = iter->info.version;
+        record.revision = iter->info.revision;
+        record.entityCount = iter->info.entityCount;
+        record.spawnPoints = iter->info.spawnPoints;
+        memcpy(record.lumpSizes, iter->info.lumpSizes, sizeof(record.lumpSizes));
+        record.pathLength = iter->path.length();
+        
+        fwrite(&record, sizeof(record), 1, fp);
+        fwrite(iter->path.chars(), record.pathLength, 1, fp);
+    }
+    
+    // Readers only ever see a complete file
+    if (fclose(fp) != 0 || rename(tempPath, MAP_CATALOG_FILE) != 0)
+        unlink(tempPath);
+    
+    modified_ = false;
+}
@@ -0,0 +1,80 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_MAPCATALOG_H_
+#define _INCLUDE_SRCDS_MAPCATALOG_H_
+
+#include <sys/types.h>
+#include "IGameAPI.h"
+#include "am-string.h"
+#include "am-linkedlist.h"
+#include "sm_symtable.h"
+
+using namespace ke;
+
+// Information about the maps of every game that has been listed, read from the header and lump
+// directory of each BSP file with pread(). The catalog is saved to .srcds_cache/map_catalog and
+// entries are keyed by path, size and modification time, so a refresh only reads maps that changed.
+class MapCatalog
+{
+public:
+    MapCatalog();
+    ~MapCatalog();
+    
+    // Brings the maps of gameDir up to date and appends them to mapList, sorted by name
+    void BuildCatalog(const char *gameDir, LinkedList<map_info_t> &mapList);
+private:
+    struct Entry
+    {
+        AString path;           // Path of the map file from the server directory
+        map_info_t info;
+        bool present;           // False once a scan of its maps directory didn't find it
+        bool seen;              // Found by the current scan
+    };
+    
+    void Load();
+    void Save();
+    void ScanDirectory(const char *dir, const char *namePrefix, int depth);
+    Entry *AddEntry(const char *path);
+    static void ReadPendingMap(void *data, size_t index);
+    
+    static bool ReadMapInfo(const char *path, map_info_t &info);
+    static void ReadEntitySummary(int fd, off_t offset, size_t length, map_info_t &info);
+private:
+    LinkedList<Entry> entries_;
+    SymbolTable index_;         // Map paths, pointing at their Entry
+    bool loaded_;
+    bool modified_;             // Needs to be saved
+    
+    // Maps found by the current scan that have to be read
+    Entry **pending_;
+    size_t pendingCount_;
+    size_t pendingCapacity_;
+};
+
+#endif // _INCLUDE_SRCDS_MAPCATALOG_H_
@@ -0,0 +1,188 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "StartupTrace.h"
+#include "GameAPI.h"
+#include "stringutil.h"
+
+#if defined(PLATFORM_LINUX)
+#include <sys/syscall.h>
+#endif
+
+// Maximum number of spans kept. Startup normally produces a few hundred.
+#define TRACE_MAX_EVENTS 8192
+
+struct TraceEvent
+{
+    const char *name;
+    char arg[128];
+    uint64_t start;
+    uint64_t end;
+    uint32_t tid;
+    bool failed;
+};
+
+bool StartupTrace::recording_ = false;
+
+static char tracePath[1024];
+// Never freed, so a span that ends on another thread while the file is being written is harmless.
+// The pages are only faulted in once tracing is used.
+static TraceEvent traceEvents[TRACE_MAX_EVENTS];
+static volatile uint32_t traceCount = 0;
+static uint64_t traceStart = 0;
+
+static uint32_t CurrentThreadId()
+{
+#if defined(PLATFORM_MACOSX)
+    return pthread_mach_thread_np(pthread_self());
+#else
+    return (uint32_t)syscall(SYS_gettid);
+#endif
+}
+
+// Writes str as the contents of a JSON string
+static void WriteEscaped(FILE *fp, const char *str)
+{
+    for (; *str; str++)
+    {
+        unsigned char c = *str;
+        
+        if (c == '"' || c == '\\')
+            fprintf(fp, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(fp, "\\u%04x", c);
+        else
+            fputc(c, fp);
+    }
+}
+
+static void WriteEvent(FILE *fp, const char *name, const char *arg, uint64_t start, uint64_t end,
+                       uint32_t tid, bool failed)
+{
+    // Timestamps are in microseconds since recording started
+    fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+            "\"ts\":%.3f,\"dur\":%.3f", name, (int)getpid(), tid, (start - traceStart) / 1000.0,
+            (end - start) / 1000.0);
+    
+    if (arg && arg[0])
+    {
+        fputs(",\"args\":{\"arg\":\"", fp);
+        WriteEscaped(fp, arg);
+        fprintf(fp, "\",\"failed\":%s}", failed ? "true" : "false");
+    }
+    else if (failed)
+    {
+        fputs(",\"args\":{\"failed\":true}", fp);
+    }
+    
+    fputc('}', fp);
+}
+
+void StartupTrace::ParseOptions(int argc, char *argv[])
+{
+    for (int i = 0; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-startuptrace") == 0)
+            strncopy(tracePath, argv[++i], sizeof(tracePath));
+    }
+    
+    if (!tracePath[0] || recording_)
+        return;
+    
+    traceCount = 0;
+    traceStart = ClockNanos();
+    recording_ = true;
+}
+
+void StartupTrace::AddEvent(const char *name, const char *arg, uint64_t start, uint64_t end,
+                            bool failed)
+{
+    uint32_t index = __sync_fetch_and_add(&traceCount, 1);
+    
+    if (index >= TRACE_MAX_EVENTS)
+        return;
+    
+    TraceEvent &event = traceEvents[index];
+    event.name = name;
+    strncopy(event.arg, arg ? arg : "", sizeof(event.arg));
+    event.start = start;
+    event.end = end;
+    event.tid = CurrentThreadId();
+    event.failed = failed;
+}
+
+void StartupTrace::Finish()
+{
+    if (!recording_)
+        return;
+    
+    recording_ = false;
+    
+    uint64_t end = ClockNanos();
+    uint32_t count = traceCount;
+    
+    if (count > TRACE_MAX_EVENTS)
+        count = TRACE_MAX_EVENTS;
+    
+    FILE *fp = fopen(tracePath, "w");
+    
+    if (fp)
+    {
+        // The overall span goes first, so the events that follow can each start with a comma
+        fputs("{\"traceEvents\":[\n", fp);
+        fprintf(fp, "{\"name\":\"startup\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+                "\"ts\":0.000,\"dur\":%.3f}", (int)getpid(), CurrentThreadId(),
+                (end - traceStart) / 1000.0);
+        
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const TraceEvent &event = traceEvents[i];
+            WriteEvent(fp, event.name, event.arg, event.start, event.end, event.tid, event.failed);
+        }
+        
+        fputs("\n],\"displayTimeUnit\":\"ms\"}\n", fp);
+        
+        if (fclose(fp) != 0)
+            GameAPI::GetInstance().GetErrorReporter().Warning("Failed to write startup trace %s: %s\n",
+                                                               tracePath, strerror(errno));
+    }
+    else
+    {
+        GameAPI::GetInstance().GetErrorReporter().Warning("Failed to open startup trace %s: %s\n",
+                                                           tracePath, strerror(errno));
+    }
+    
+    if (traceCount > TRACE_MAX_EVENTS)
+        GameAPI::GetInstance().GetErrorReporter().Warning("Startup trace was truncated to %d events\n",
+                                                           TRACE_MAX_EVENTS);
+}
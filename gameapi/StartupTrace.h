@@ -0,0 +1,89 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_STARTUPTRACE_H_
+#define _INCLUDE_SRCDS_STARTUPTRACE_H_
+
+#include <stdint.h>
+#include "Clock.h"
+
+// Timeline of server startup (library loads, symbol lookups, detours and module loads), enabled
+// with -startuptrace <file>. The file is written in the Chrome trace event format when the server
+// starts its first frame, so it can be opened with chrome://tracing or Perfetto.
+class StartupTrace
+{
+public:
+    static void ParseOptions(int argc, char *argv[]);
+    
+    static inline bool IsRecording()
+    {
+        return recording_;
+    }
+    
+    // Records one completed span. name must be a string literal, arg is copied (and may be null).
+    static void AddEvent(const char *name, const char *arg, uint64_t start, uint64_t end,
+                         bool failed);
+    
+    // Writes the trace file and stops recording
+    static void Finish();
+private:
+    static bool recording_;
+};
+
+// Times the enclosing scope as one span of the startup trace
+class TraceScope
+{
+public:
+    TraceScope(const char *name, const char *arg)
+        : name_(name), arg_(arg), start_(0), failed_(false)
+    {
+        if (StartupTrace::IsRecording())
+            start_ = ClockNanos();
+    }
+    
+    ~TraceScope()
+    {
+        if (start_ && StartupTrace::IsRecording())
+            StartupTrace::AddEvent(name_, arg_, start_, ClockNanos(), failed_);
+    }
+    
+    void SetFailed(bool failed = true)
+    {
+        failed_ = failed;
+    }
+private:
+    const char *name_;
+    const char *arg_;
+    uint64_t start_;
+    bool failed_;
+};
+
+#define TRACE_SCOPE(name, arg) TraceScope _traceScope(name, arg)
+#define TRACE_SCOPE_FAILED(failed) _traceScope.SetFailed(failed)
+
+#endif // _INCLUDE_SRCDS_STARTUPTRACE_H_
@@ -0,0 +1,396 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "ThreadTuning.h"
+#include "GameLib.h"
+#include "stringutil.h"
+
+#if defined(PLATFORM_MACOSX)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <mach-o/dyld.h>
+#include <mach-o/loader.h>
+#elif defined(PLATFORM_LINUX)
+#include <link.h>
+#endif
+
+#if defined(RUSAGE_THREAD)
+static const int kFaultScope = RUSAGE_THREAD;
+#else
+static const int kFaultScope = RUSAGE_SELF;
+#endif
+
+// Libraries that run during every server frame
+static const char *kHotLibraries[] =
+{
+    "engine",
+    "dedicated",
+    "server",
+    "tier0",
+    "vstdlib",
+    "datacache",
+    "vphysics",
+    "filesystem_stdio",
+    nullptr
+};
+
+// Checks if a library path refers to one of the hot libraries (i.e. bin/libtier0.dylib)
+static bool IsHotLibrary(const char *path)
+{
+    const char *name = strrchr(path, PLATFORM_SEP_CHAR);
+    name = name ? name + 1 : path;
+    
+    if (strncmp(name, "lib", 3) == 0)
+        name += 3;
+    
+    size_t len = strcspn(name, ".");
+    
+    // Linux servers may use libraries with a _srv suffix
+    if (len > 4 && strncmp(&name[len - 4], "_srv", 4) == 0)
+        len -= 4;
+    
+    for (const char **lib = kHotLibraries; *lib; lib++)
+    {
+        if (strlen(*lib) == len && strncmp(name, *lib, len) == 0)
+            return true;
+    }
+    
+    return false;
+}
+
+// Calls func(cpu) for each CPU in a list like "0-1,4"
+template <typename F>
+static void ParseCpuList(const char *list, F func)
+{
+    while (*list)
+    {
+        char *end;
+        long first = strtol(list, &end, 10);
+        long last = first;
+        
+        if (end == list)
+            break;
+        
+        if (*end == '-')
+        {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+        }
+        
+        for (long cpu = first; cpu <= last; cpu++)
+            func(int(cpu));
+        
+        list = (*end == ',') ? end + 1 : end;
+    }
+}
+
+ThreadTuning::ThreadTuning(ErrorReporter *reporter)
+    : reporter_(reporter),
+      enabled_(false),
+      thread_(pthread_self()),
+      rtPriority_(0),
+      niceValue_(0),
+      mlock_(false),
+      bindNow_(false),
+      lockedBytes_(0),
+      frameMinorFaults_(0),
+      frameMajorFaults_(0),
+      minorFaults_(0),
+      majorFaults_(0)
+{
+    cpus_[0] = '\0';
+}
+
+void ThreadTuning::ParseOptions(int argc, char *argv[])
+{
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-cpus") == 0 && i + 1 < argc)
+            strncopy(cpus_, argv[++i], sizeof(cpus_));
+        else if (strcmp(argv[i], "-rtprio") == 0 && i + 1 < argc)
+            rtPriority_ = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-nice") == 0 && i + 1 < argc)
+            niceValue_ = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-mlock") == 0)
+            mlock_ = true;
+        else if (strcmp(argv[i], "-bindnow") == 0)
+            bindNow_ = true;
+    }
+    
+    // Libraries loaded from here on are bound right away
+    GameLib::SetBindNow(bindNow_);
+    
+    enabled_ = cpus_[0] || rtPriority_ > 0 || niceValue_ != 0 || mlock_ || bindNow_;
+}
+
+bool ThreadTuning::IsEnabled() const
+{
+    return enabled_;
+}
+
+void ThreadTuning::ApplyToCurrentThread()
+{
+    thread_ = pthread_self();
+    
+    if (cpus_[0])
+    {
+#if defined(PLATFORM_LINUX)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        ParseCpuList(cpus_, [&set](int cpu) { CPU_SET(cpu, &set); });
+        
+        if (pthread_setaffinity_np(thread_, sizeof(set), &set) != 0)
+            reporter_->Warning("Failed to set CPU affinity to %s\n", cpus_);
+#elif defined(PLATFORM_MACOSX)
+        // Threads with the same affinity tag share a core, threads with different tags don't
+        thread_affinity_policy_data_t policy;
+        policy.affinity_tag = atoi(cpus_) + 1;
+        
+        if (thread_policy_set(pthread_mach_thread_np(thread_), THREAD_AFFINITY_POLICY,
+                              (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT) != KERN_SUCCESS)
+        {
+            reporter_->Warning("Failed to set thread affinity tag for CPU %s\n", cpus_);
+        }
+#endif
+    }
+    
+    if (rtPriority_ > 0)
+    {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = rtPriority_;
+        
+        int err = pthread_setschedparam(thread_, SCHED_FIFO, &param);
+        if (err != 0)
+            reporter_->Warning("Failed to set SCHED_FIFO priority %d: %s\n", rtPriority_, strerror(err));
+    }
+    
+    if (niceValue_ != 0 && setpriority(PRIO_PROCESS, 0, niceValue_) != 0)
+        reporter_->Warning("Failed to set nice value %d: %s\n", niceValue_, strerror(errno));
+}
+
+#if defined(PLATFORM_LINUX)
+template <typename F>
+static int VisitHotSegments(struct dl_phdr_info *info, size_t size, void *data)
+{
+    F &func = *(F *)data;
+    
+    if (!info->dlpi_name || !IsHotLibrary(info->dlpi_name))
+        return 0;
+    
+    for (int i = 0; i < info->dlpi_phnum; i++)
+    {
+        const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+        
+        if (phdr.p_type == PT_LOAD && (phdr.p_flags & PF_R))
+            func(info->dlpi_name, (void *)(info->dlpi_addr + phdr.p_vaddr), size_t(phdr.p_memsz));
+    }
+    
+    return 0;
+}
+#endif
+
+// Calls func(path, address, size) for each loaded segment of the hot libraries that is needed
+// while running frames
+template <typename F>
+static void ForEachHotSegment(F func)
+{
+#if defined(PLATFORM_MACOSX)
+#if defined(__x86_64__)
+    typedef struct mach_header_64 MachHeader;
+    typedef struct segment_command_64 SegmentCommand;
+    const uint32_t segmentCmd = LC_SEGMENT_64;
+#else
+    typedef struct mach_header MachHeader;
+    typedef struct segment_command SegmentCommand;
+    const uint32_t segmentCmd = LC_SEGMENT;
+#endif
+    
+    for (uint32_t i = 0; i < _dyld_image_count(); i++)
+    {
+        const char *name = _dyld_get_image_name(i);
+        const MachHeader *header = (const MachHeader *)_dyld_get_image_header(i);
+        
+        if (!name || !header || !IsHotLibrary(name))
+            continue;
+        
+        intptr_t slide = _dyld_get_image_vmaddr_slide(i);
+        const struct load_command *cmd = (const struct load_command *)(header + 1);
+        
+        for (uint32_t c = 0; c < header->ncmds; c++)
+        {
+            if (cmd->cmd == segmentCmd)
+            {
+                const SegmentCommand *seg = (const SegmentCommand *)cmd;
+                
+                // Symbol tables and the like aren't needed while running frames
+                if (strcmp(seg->segname, "__PAGEZERO") != 0 &&
+                    strcmp(seg->segname, "__LINKEDIT") != 0 && (seg->initprot & VM_PROT_READ))
+                {
+                    func(name, (void *)(seg->vmaddr + slide), size_t(seg->vmsize));
+                }
+            }
+            
+            cmd = (const struct load_command *)((const char *)cmd + cmd->cmdsize);
+        }
+    }
+#elif defined(PLATFORM_LINUX)
+    dl_iterate_phdr(VisitHotSegments<F>, &func);
+#endif
+}
+
+void ThreadTuning::LockLibraries()
+{
+    if (!mlock_)
+        return;
+    
+    uint64_t &lockedBytes = lockedBytes_;
+    
+    ForEachHotSegment([&lockedBytes](const char *path, void *addr, size_t size) {
+        if (mlock(addr, size) == 0)
+            lockedBytes += size;
+    });
+    
+    if (lockedBytes_ == 0)
+        reporter_->Warning("Failed to lock game libraries into memory: %s\n", strerror(errno));
+}
+
+void ThreadTuning::BindLibraries()
+{
+    if (!bindNow_)
+        return;
+    
+    const char *lastPath = nullptr;
+    bool prefault = !mlock_;
+    uintptr_t pageSize = getpagesize();
+    
+    ForEachHotSegment([&lastPath, prefault, pageSize](const char *path, void *addr, size_t size) {
+        // Opening a library again with RTLD_NOW has the dynamic linker bind the lazy symbol
+        // pointers that haven't been used yet
+        if (path != lastPath)
+        {
+            void *handle = dlopen(path, RTLD_NOW | RTLD_NOLOAD);
+            
+            if (handle)
+                dlclose(handle);
+            
+            lastPath = path;
+        }
+        
+        // Fault in the pages now instead of during the first frames (mlock does this already)
+        if (prefault)
+        {
+            uintptr_t page = uintptr_t(addr) & ~(pageSize - 1);
+            uintptr_t end = uintptr_t(addr) + size;
+            
+            for (; page < end; page += pageSize)
+                (void)*(volatile const char *)page;
+        }
+    });
+}
+
+void ThreadTuning::SampleFaults(uint64_t *minor, uint64_t *major)
+{
+    struct rusage usage;
+    
+    // Mach has no per-thread fault counters, so there this includes faults from every thread
+    if (getrusage(kFaultScope, &usage) == 0)
+    {
+        *minor = usage.ru_minflt;
+        *major = usage.ru_majflt;
+    }
+}
+
+void ThreadTuning::EndFrame()
+{
+    if (!enabled_)
+        return;
+    
+    uint64_t minor = frameMinorFaults_;
+    uint64_t major = frameMajorFaults_;
+    SampleFaults(&minor, &major);
+    
+    minorFaults_ += minor - frameMinorFaults_;
+    majorFaults_ += major - frameMajorFaults_;
+}
+
+void ThreadTuning::DescribeAffinity(char *buffer, size_t maxlength)
+{
+    strncopy(buffer, "any", maxlength);
+    
+#if defined(PLATFORM_LINUX)
+    cpu_set_t set;
+    
+    if (pthread_getaffinity_np(thread_, sizeof(set), &set) == 0)
+    {
+        size_t len = 0;
+        buffer[0] = '\0';
+        
+        for (int cpu = 0; cpu < CPU_SETSIZE && len < maxlength; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+                len += snprintf(&buffer[len], maxlength - len, len ? ",%d" : "%d", cpu);
+        }
+    }
+#elif defined(PLATFORM_MACOSX)
+    thread_affinity_policy_data_t policy;
+    mach_msg_type_number_t count = THREAD_AFFINITY_POLICY_COUNT;
+    boolean_t getDefault = false;
+    
+    if (thread_policy_get(pthread_mach_thread_np(thread_), THREAD_AFFINITY_POLICY,
+                          (thread_policy_t)&policy, &count, &getDefault) == KERN_SUCCESS &&
+        policy.affinity_tag != THREAD_AFFINITY_TAG_NULL)
+    {
+        snprintf(buffer, maxlength, "tag %d", policy.affinity_tag);
+    }
+#endif
+}
+
+void ThreadTuning::GetStats(sched_stats_t *stats)
+{
+    struct sched_param param;
+    
+    memset(stats, 0, sizeof(sched_stats_t));
+    DescribeAffinity(stats->affinity, sizeof(stats->affinity));
+    
+    if (pthread_getschedparam(thread_, &stats->policy, &param) == 0)
+        stats->priority = param.sched_priority;
+    
+    stats->lockedBytes = lockedBytes_;
+    stats->minorFaults = minorFaults_;
+    stats->majorFaults = majorFaults_;
+    stats->threadFaults = kFaultScope != RUSAGE_SELF;
+}
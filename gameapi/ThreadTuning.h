@@ -0,0 +1,98 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_THREADTUNING_H_
+#define _INCLUDE_SRCDS_THREADTUNING_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include "IGameAPI.h"
+#include "ErrorReporter.h"
+
+// Optional scheduling tweaks for the server frame thread, taken from the command line:
+//
+//   -cpus <list>     Pin the thread to a CPU set, i.e. "2" or "0-1,4". OS X can't pin threads, so
+//                    the first CPU is used as an affinity tag to keep the thread on its own core.
+//   -rtprio <n>      Run the thread with SCHED_FIFO at priority n
+//   -nice <n>        Set the process nice value
+//   -mlock           Lock the code and data of the hot game libraries into memory
+//   -bindnow         Bind every symbol of the game libraries and fault in their pages at startup,
+//                    rather than during the first frames
+//
+// Page faults are counted during server frames whenever any of these are used. They're counted for
+// the frame thread alone where the OS supports it (Linux), and for the whole process otherwise.
+class ThreadTuning
+{
+public:
+    ThreadTuning(ErrorReporter *reporter);
+    
+    void ParseOptions(int argc, char *argv[]);
+    bool IsEnabled() const;
+    
+    // Applies affinity and scheduling options to the calling thread
+    void ApplyToCurrentThread();
+    
+    // Locks the hot libraries into memory if -mlock was given. Call after they have been loaded.
+    void LockLibraries();
+    
+    // Binds the lazy symbols of the hot libraries and faults in their pages if -bindnow was given.
+    // Call after they have been loaded.
+    void BindLibraries();
+    
+    // Page fault accounting around a server frame
+    inline void BeginFrame()
+    {
+        if (enabled_)
+            SampleFaults(&frameMinorFaults_, &frameMajorFaults_);
+    }
+    
+    void EndFrame();
+    
+    void GetStats(sched_stats_t *stats);
+private:
+    static void SampleFaults(uint64_t *minor, uint64_t *major);
+    void DescribeAffinity(char *buffer, size_t maxlength);
+private:
+    ErrorReporter *reporter_;
+    bool enabled_;
+    pthread_t thread_;
+    
+    char cpus_[64];
+    int rtPriority_;
+    int niceValue_;
+    bool mlock_;
+    bool bindNow_;
+    
+    uint64_t lockedBytes_;
+    uint64_t frameMinorFaults_;
+    uint64_t frameMajorFaults_;
+    volatile uint64_t minorFaults_;
+    volatile uint64_t majorFaults_;
+};
+
+#endif // _INCLUDE_SRCDS_THREADTUNING_H_
@@ -53,13 +53,56 @@ inline void SetMemExec(void *address, size_t size)
 	SetMemAccess(address, size, SH_MEM_READ|SH_MEM_EXEC);
 }
 
+/* Largest patch AtomicCodeWrite can write while other threads may be running the code */
+#define ATOMIC_PATCH_MAX 8
+
+/*
+ * Writes code at target without letting another thread execute a half written instruction.
+ * Patches of up to 8 bytes are written with a single locked cmpxchg8b/cmpxchg, using the aligned
+ * word that holds them if there is one (a split locked write is still atomic on x86, just slower).
+ *
+ * Longer patches can't be written atomically. A thread that is already running the bytes being
+ * replaced would continue in the middle of the new ones, so they must only be written while no
+ * other thread can be running the target, i.e. when a detour is first installed or torn down.
+ */
+inline void AtomicCodeWrite(unsigned char *target, const unsigned char *bytes, size_t len)
+{
+	if (len > ATOMIC_PATCH_MAX)
+	{
+		memcpy(target, bytes, len);
+		__sync_synchronize();
+		return;
+	}
+
+	size_t offset = (uintptr_t)target & 7;
+
+	if (offset + len > 8)
+	{
+		offset = 0;
+	}
+
+	volatile uint64_t *word = (volatile uint64_t *)(target - offset);
+	uint64_t oldWord, newWord;
+
+	do
+	{
+		oldWord = *word;
+		newWord = oldWord;
+		memcpy((unsigned char *)&newWord + offset, bytes, len);
+	} while (!__sync_bool_compare_and_swap(word, oldWord, newWord));
+}
+
 inline void DoGatePatch(unsigned char *target, void *callback)
 {
+	unsigned char gate[5];
+
+	gate[0] = IA32_JMP_IMM32;
+	*(int32_t *)(&gate[1]) = int32_t((unsigned char *)callback - (target + 5));
+
 	SetMemPatchable(target, 5);
 
-	target[0] = IA32_JMP_IMM32;
-	*(int32_t *)(&target[1]) = int32_t((unsigned char *)callback - (target + 5));
-	
+	AtomicCodeWrite(target, gate, 5);
+
 	SetMemExec(target, 5);
 }
 
@@ -77,7 +120,7 @@ inline void ApplyPatch(void *address, int offset, const patch_t *patch, patch_t
 		restore->bytes = patch->bytes;
 	}
 
-	memcpy(addr, patch->patch, patch->bytes);
+	AtomicCodeWrite(addr, patch->patch, patch->bytes);
 
 	SetMemExec(address, sizeof(patch->patch));
 }
@@ -31,9 +31,17 @@
 
 #include "detours.h"
 #include "asm.h"
+#include <pthread.h>
 
 CPageAlloc GenBuffer::ms_Allocator(16);
 
+/*
+ * Serializes arming and disarming. Detours are toggled from the engine thread and the API threads,
+ * and a thread that restores page protection while another one is still writing makes that write fault.
+ * One lock covers all detours since their targets can share a page.
+ */
+static pthread_mutex_t g_PatchLock = PTHREAD_MUTEX_INITIALIZER;
+
 CDetour *CDetourManager::CreateDetour(void *callbackfunction, void **trampoline, void *addr)
 {
 	CDetour *detour = new CDetour(callbackfunction, trampoline);
@@ -90,6 +98,11 @@ bool CDetour::IsEnabled()
 	return enabled;
 }
 
+bool CDetour::IsDetoured()
+{
+	return detoured;
+}
+
 void *CDetour::GetTargetAddr()
 {
 	return detour_address;
@@ -143,19 +156,31 @@ void CDetour::DeleteDetour()
 
 void CDetour::EnableDetour()
 {
+	pthread_mutex_lock(&g_PatchLock);
+
 	if (!detoured)
 	{
 		DoGatePatch((unsigned char *)detour_address, detour_callback);
 		detoured = true;
 	}
+
+	pthread_mutex_unlock(&g_PatchLock);
 }
 
 void CDetour::DisableDetour()
 {
+	pthread_mutex_lock(&g_PatchLock);
+
 	if (detoured)
 	{
+		/* Only the jump was written over, so only it has to be put back */
+		patch_t gate = detour_restore;
+		gate.bytes = OP_JMP_SIZE;
+
 		/* Remove the patch */
-		ApplyPatch(detour_address, 0, &detour_restore, NULL);
+		ApplyPatch(detour_address, 0, &gate, NULL);
 		detoured = false;
 	}
+
+	pthread_mutex_unlock(&g_PatchLock);
 }
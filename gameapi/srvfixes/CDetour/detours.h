@@ -32,6 +32,7 @@
 
 #include <sh_include.h>
 #include "detourhelpers.h"
+#include "StartupTrace.h"
 
 /**
  * CDetours class for SourceMod Extensions by pRED*
@@ -108,8 +109,9 @@ ret name##Class::name(p1type p1name, p2type p2name, p3type p3name)
 #define GET_STATIC_CALLBACK(name) (void *)&name
 #define GET_STATIC_TRAMPOLINE(name) (void **)&name##_Actual
 
-#define DETOUR_CREATE_MEMBER(name, addr) CDetourManager::CreateDetour(GET_MEMBER_CALLBACK(name), GET_MEMBER_TRAMPOLINE(name), addr)
-#define DETOUR_CREATE_STATIC(name, addr) CDetourManager::CreateDetour(GET_STATIC_CALLBACK(name), GET_STATIC_TRAMPOLINE(name), addr)
+// The TraceScope temporary lives until the end of the full expression, so it times CreateDetour
+#define DETOUR_CREATE_MEMBER(name, addr) (TraceScope("CreateDetour", #name), CDetourManager::CreateDetour(GET_MEMBER_CALLBACK(name), GET_MEMBER_TRAMPOLINE(name), addr))
+#define DETOUR_CREATE_STATIC(name, addr) (TraceScope("CreateDetour", #name), CDetourManager::CreateDetour(GET_STATIC_CALLBACK(name), GET_STATIC_TRAMPOLINE(name), addr))
 
 class GenericClass {};
 typedef void (GenericClass::*VoidFunc)();
@@ -137,10 +139,17 @@ public:
 
 	/**
 	 * These would be somewhat self-explanatory I hope
+	 *
+	 * Both only (atomically) patch the jump at the start of the target function and leave the
+	 * trampoline alone, so a detour can be armed and disarmed at runtime as often as needed.
+	 * They can be called from any thread; all patching is done under one lock.
 	 */
 	void EnableDetour();
 	void DisableDetour();
 
+	/* Returns true if the jump to the callback is currently patched in */
+	bool IsDetoured();
+
 	void *GetTargetAddr();
 	void SetTargetAddr(void *addr);
 
@@ -159,6 +168,7 @@ private:
 	void DeleteDetour();
 
 	bool enabled;
+	/* Only changed while holding the patch lock */
 	bool detoured;
 
 	patch_t detour_restore;
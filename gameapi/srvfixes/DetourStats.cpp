@@ -0,0 +1,71 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <string.h>
+#include "DetourStats.h"
+
+DetourStats *DetourStats::head_ = nullptr;
+
+DetourStats::DetourStats(const char *name)
+    : name_(name),
+      calls_(0),
+      totalCycles_(0),
+      maxCycles_(0)
+{
+    memset((void *)histogram_, 0, sizeof(histogram_));
+    
+    // Static initialization is single threaded, so no locking is needed here
+    next_ = head_;
+    head_ = this;
+}
+
+void DetourStats::CopyTo(detour_stats_t *stats)
+{
+    stats->name = name_;
+    stats->calls = calls_;
+    stats->totalCycles = totalCycles_;
+    stats->maxCycles = maxCycles_;
+    
+    for (int i = 0; i < DETOUR_STATS_BUCKETS; i++)
+        stats->histogram[i] = histogram_[i];
+}
+
+size_t DetourStats::GetAll(detour_stats_t *stats, size_t maxStats)
+{
+    size_t count = 0;
+    
+    for (DetourStats *d = head_; d; d = d->next_)
+    {
+        if (count < maxStats)
+            d->CopyTo(&stats[count]);
+        
+        count++;
+    }
+    
+    return count;
+}
@@ -0,0 +1,109 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_DETOURSTATS_H_
+#define _INCLUDE_SRCDS_DETOURSTATS_H_
+
+#include <stdint.h>
+#include "IGameAPI.h"
+
+// Reads the CPU's time stamp counter
+static inline uint64_t ReadTSC()
+{
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Call counter and latency histogram for a single detour. Instances register themselves in a
+// global list when constructed, so they should be declared at file scope with DETOUR_STATS.
+class DetourStats
+{
+public:
+    DetourStats(const char *name);
+    
+    // Records one call that took the given number of TSC cycles. Safe to call from any thread.
+    inline void Record(uint64_t cycles)
+    {
+        int bucket = 63 - __builtin_clzll(cycles | 1);
+        
+        if (bucket >= DETOUR_STATS_BUCKETS)
+            bucket = DETOUR_STATS_BUCKETS - 1;
+        
+        __sync_fetch_and_add(&calls_, 1);
+        __sync_fetch_and_add(&totalCycles_, cycles);
+        __sync_fetch_and_add(&histogram_[bucket], 1);
+        
+        uint64_t max = maxCycles_;
+        while (cycles > max && !__sync_bool_compare_and_swap(&maxCycles_, max, cycles))
+            max = maxCycles_;
+    }
+    
+    // Copies up to maxStats entries into stats and returns the number of registered detours
+    static size_t GetAll(detour_stats_t *stats, size_t maxStats);
+private:
+    void CopyTo(detour_stats_t *stats);
+private:
+    const char *name_;
+    volatile uint64_t calls_;
+    volatile uint64_t totalCycles_;
+    volatile uint64_t maxCycles_;
+    volatile uint64_t histogram_[DETOUR_STATS_BUCKETS];
+    DetourStats *next_;
+    
+    static DetourStats *head_;
+};
+
+// Times the enclosing scope and records it when it goes out of scope
+class DetourProfiler
+{
+public:
+    DetourProfiler(DetourStats &stats) : stats_(stats), start_(ReadTSC())
+    {
+    }
+    
+    ~DetourProfiler()
+    {
+        stats_.Record(ReadTSC() - start_);
+    }
+private:
+    DetourStats &stats_;
+    uint64_t start_;
+};
+
+// Only compiled into the detours if SRCDS_DETOUR_STATS is defined.
+// DETOUR_STATS(name) goes at file scope, DETOUR_PROFILE(name) at the top of the detour.
+#if defined(SRCDS_DETOUR_STATS)
+    #define DETOUR_STATS(name)   static DetourStats name##_Stats(#name)
+    #define DETOUR_PROFILE(name) DetourProfiler name##_Profiler(name##_Stats)
+#else
+    #define DETOUR_STATS(name)
+    #define DETOUR_PROFILE(name)
+#endif
+
+#endif // _INCLUDE_SRCDS_DETOURSTATS_H_
@@ -26,11 +26,13 @@
  * this exception to all derivative works.
  */
 
+#include <stdlib.h>
 #include <dlfcn.h>
 #include <mach/task.h>
 #include <mach-o/dyld_images.h>
 #include <mach-o/loader.h>
 #include "HSGameLib.h"
+#include "StartupTrace.h"
 
 static struct dyld_all_image_infos *GetDyldImageInfo()
 {
@@ -62,13 +64,15 @@ static struct dyld_all_image_infos *GetDyldImageInfo()
 }
 
 HSGameLib::HSGameLib()
-    : GameLib(), baseAddress_(0), lastPosition_(0), valid_(false)
+    : GameLib(), baseAddress_(0), lastPosition_(0), addressIndex_(nullptr), addressCount_(0),
+      valid_(false)
 {
 
 }
 
 HSGameLib::HSGameLib(const char *name)
-    : GameLib(name), baseAddress_(0), lastPosition_(0), valid_(false)
+    : GameLib(name), baseAddress_(0), lastPosition_(0), addressIndex_(nullptr), addressCount_(0),
+      valid_(false)
 {
     if (!IsLoaded())
         return;
@@ -76,6 +80,11 @@ HSGameLib::HSGameLib(const char *name)
     Initialize();
 }
 
+HSGameLib::~HSGameLib()
+{
+    free(addressIndex_);
+}
+
 bool HSGameLib::Load(const char *name)
 {
     if (IsLoaded())
@@ -90,6 +99,20 @@ bool HSGameLib::Load(const char *name)
     return IsValid();
 }
 
+bool HSGameLib::Attach(const void *base, const char *path)
+{
+    if (IsLoaded())
+        Close();
+    
+    Invalidate();
+    
+    name_ = path;
+    baseAddress_ = (uintptr_t)base;
+    ReadSymbolTable();
+    
+    return IsValid();
+}
+
 bool HSGameLib::IsValid() const
 {
     return valid_;
@@ -99,6 +122,8 @@ size_t HSGameLib::ResolveHiddenSymbols(SymbolInfo *list, const char **names)
 {
     size_t invalid = 0;
     
+    TRACE_SCOPE("HSGameLib::ResolveHiddenSymbols", GetName().chars());
+    
     while (*names && *names[0])
     {
         SymbolInfo *info = list++;
@@ -116,10 +141,81 @@ size_t HSGameLib::ResolveHiddenSymbols(SymbolInfo *list, const char **names)
         names++;
     }
     
+    TRACE_SCOPE_FAILED(invalid != 0);
     return invalid;
 }
 
+static int CompareAddressEntries(const void *a, const void *b)
+{
+    uintptr_t addrA = *(const uintptr_t *)a;
+    uintptr_t addrB = *(const uintptr_t *)b;
+    
+    if (addrA < addrB)
+        return -1;
+    
+    return addrA > addrB;
+}
+
+const char *HSGameLib::FindSymbolByAddress(const void *addr, uintptr_t *offset)
+{
+    if (!valid_)
+        return nullptr;
+    
+    if (!addressIndex_)
+    {
+        addressIndex_ = (AddressEntry *)malloc(sizeof(AddressEntry) * symbolCount_);
+        
+        if (!addressIndex_)
+            return nullptr;
+        
+        // Only symbols defined in a section of this library can contain code
+        for (uint32_t i = 0; i < symbolCount_; i++)
+        {
+            struct nlist &sym = symbolTable_[i];
+            
+            if ((sym.n_type & N_STAB) || (sym.n_type & N_TYPE) != N_SECT || !sym.n_value)
+                continue;
+            
+            AddressEntry &entry = addressIndex_[addressCount_++];
+            entry.address = baseAddress_ + sym.n_value;
+            entry.name = stringTable_ + sym.n_un.n_strx + 1;
+        }
+        
+        qsort(addressIndex_, addressCount_, sizeof(AddressEntry), CompareAddressEntries);
+    }
+    
+    uintptr_t target = (uintptr_t)addr;
+    
+    if (!addressCount_ || target < addressIndex_[0].address)
+        return nullptr;
+    
+    // Find the last entry at or below the address
+    uint32_t low = 0;
+    uint32_t high = addressCount_;
+    
+    while (high - low > 1)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        
+        if (addressIndex_[mid].address <= target)
+            low = mid;
+        else
+            high = mid;
+    }
+    
+    if (offset)
+        *offset = target - addressIndex_[low].address;
+    
+    return addressIndex_[low].name;
+}
+
 void HSGameLib::Initialize()
+{
+    baseAddress_ = GetBaseAddress();
+    ReadSymbolTable();
+}
+
+void HSGameLib::ReadSymbolTable()
 {
     struct mach_header *fileHdr;
     struct load_command *loadCmds;
@@ -128,7 +224,7 @@ void HSGameLib::Initialize()
     uint32_t loadCmdCount = 0;
     uintptr_t linkEditAddr = 0;
     
-    baseAddress_ = GetBaseAddress();
+    TRACE_SCOPE("HSGameLib::Initialize", GetName().chars());
     
     if (!baseAddress_)
         return;
@@ -180,6 +276,10 @@ void HSGameLib::Invalidate()
 {
     if (!table_.IsEmpty())
         table_.Destroy();
+    
+    free(addressIndex_);
+    addressIndex_ = nullptr;
+    addressCount_ = 0;
 
     valid_ = false;
 }
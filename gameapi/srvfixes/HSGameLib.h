@@ -52,10 +52,15 @@ class HSGameLib : public GameLib
 public:
     HSGameLib();
     explicit HSGameLib(const char *name);
+    ~HSGameLib();
     
     bool Load(const char *name);
     bool IsValid() const;
     
+    // Reads the symbol table of the image that is mapped at base instead of loading a library, so
+    // nothing is opened or initialized. Only the hidden symbol lookups work on such an image.
+    bool Attach(const void *base, const char *path);
+    
     template <typename T>
     T ResolveHiddenSymbol(const char *symbol)
     {
@@ -63,8 +68,20 @@ public:
     }
     
     size_t ResolveHiddenSymbols(SymbolInfo *list, const char **names);
+    
+    // Returns the name of the symbol that contains addr (the closest one at or below it) and its
+    // offset from that symbol, or null if addr isn't inside the library. The first call sorts the
+    // symbol table by address.
+    const char *FindSymbolByAddress(const void *addr, uintptr_t *offset);
 private:
+    struct AddressEntry
+    {
+        uintptr_t address;
+        const char *name;
+    };
+    
     void Initialize();
+    void ReadSymbolTable();
     void Invalidate();
     uintptr_t GetBaseAddress();
     void *GetHiddenSymbolAddr(const char *symbol);
@@ -75,6 +92,8 @@ private:
     RawSymbolTable symbolTable_;
     const char *stringTable_;
     uint32_t symbolCount_;
+    AddressEntry *addressIndex_;
+    uint32_t addressCount_;
     bool valid_;
 };
 
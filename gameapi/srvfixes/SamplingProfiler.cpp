@@ -0,0 +1,391 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include "SamplingProfiler.h"
+#include "HSGameLib.h"
+#include "Clock.h"
+#include "stringutil.h"
+
+// Turns sampled addresses into "module`function" names
+class ProfileSymbolizer
+{
+public:
+    ProfileSymbolizer() : imageCount_(0)
+    {
+    }
+    
+    ~ProfileSymbolizer()
+    {
+        for (size_t i = 0; i < imageCount_; i++)
+            delete images_[i].lib;
+    }
+    
+    void Describe(uintptr_t address, FILE *fp)
+    {
+        Dl_info info;
+        
+        if (!dladdr((void *)address, &info) || !info.dli_fname)
+        {
+            fprintf(fp, "0x%lx", (unsigned long)address);
+            return;
+        }
+        
+        const char *module = strrchr(info.dli_fname, '/');
+        module = module ? module + 1 : info.dli_fname;
+        
+        const char *name = nullptr;
+        uintptr_t offset = 0;
+        HSGameLib *lib = FindLibrary(info);
+        
+        // The hidden symbol table knows about functions that dladdr() can't see
+        if (lib)
+            name = lib->FindSymbolByAddress((void *)address, &offset);
+        
+        if (!name)
+            name = info.dli_sname;
+        
+        if (!name)
+        {
+            fprintf(fp, "%s`0x%lx", module, (unsigned long)(address - (uintptr_t)info.dli_fbase));
+            return;
+        }
+        
+        int status;
+        char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        
+        fprintf(fp, "%s`", module);
+        
+        // Semicolons separate frames in the collapsed format
+        for (const char *c = demangled ? demangled : name; *c; c++)
+            fputc(*c == ';' ? ':' : *c, fp);
+        
+        free(demangled);
+    }
+private:
+    HSGameLib *FindLibrary(const Dl_info &info)
+    {
+        for (size_t i = 0; i < imageCount_; i++)
+        {
+            if (images_[i].base == (uintptr_t)info.dli_fbase)
+                return images_[i].lib;
+        }
+        
+        if (imageCount_ == sizeof(images_) / sizeof(images_[0]))
+            return nullptr;
+        
+        Image &image = images_[imageCount_++];
+        image.base = (uintptr_t)info.dli_fbase;
+        image.lib = nullptr;
+        
+        // System libraries live in the shared cache, where the symbol table can't be read the same
+        // way. Their exported symbols are good enough.
+        if (strncmp(info.dli_fname, "/usr/", 5) == 0 || strncmp(info.dli_fname, "/System/", 8) == 0)
+            return nullptr;
+        
+        // Read the image the address is in where it is mapped. Loading the library by name could
+        // find (and initialize) a different one while the profile is being written.
+        HSGameLib *lib = new HSGameLib();
+        
+        if (!lib->Attach(info.dli_fbase, info.dli_fname))
+        {
+            delete lib;
+            return nullptr;
+        }
+        
+        image.lib = lib;
+        return lib;
+    }
+private:
+    struct Image
+    {
+        uintptr_t base;
+        HSGameLib *lib;
+    };
+    
+    Image images_[128];
+    size_t imageCount_;
+};
+
+SamplingProfiler::SamplingProfiler(ErrorReporter *reporter)
+    : reporter_(reporter), rate_(997), target_(0), stackLow_(0), stackHigh_(0), running_(false),
+      stop_(false), samples_(nullptr), sampleCount_(0)
+{
+    path_[0] = '\0';
+    pthread_mutex_init(&lock_, nullptr);
+}
+
+SamplingProfiler::~SamplingProfiler()
+{
+    Stop();
+    free(samples_);
+    pthread_mutex_destroy(&lock_);
+}
+
+void SamplingProfiler::ParseOptions(int argc, char *argv[])
+{
+    for (int i = 0; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-profile") == 0)
+            strncopy(path_, argv[++i], sizeof(path_));
+        else if (strcmp(argv[i], "-profilerate") == 0)
+            rate_ = atoi(argv[++i]);
+    }
+    
+    if (rate_ < 1)
+        rate_ = 1;
+    else if (rate_ > 10000)
+        rate_ = 10000;
+}
+
+bool SamplingProfiler::IsRunning() const
+{
+    return running_;
+}
+
+bool SamplingProfiler::Start()
+{
+    if (!path_[0] || running_)
+        return running_;
+    
+    if (!samples_)
+    {
+        samples_ = (Sample *)malloc(sizeof(Sample) * PROFILE_MAX_SAMPLES);
+        
+        if (!samples_)
+        {
+            reporter_->Warning("Failed to allocate memory for the profiler.\n");
+            return false;
+        }
+    }
+    
+    pthread_t self = pthread_self();
+    target_ = pthread_mach_thread_np(self);
+    stackHigh_ = (uintptr_t)pthread_get_stackaddr_np(self);
+    stackLow_ = stackHigh_ - pthread_get_stacksize_np(self);
+    
+    stop_ = false;
+    
+    if (pthread_create(&thread_, nullptr, ThreadMain, this) != 0)
+    {
+        reporter_->Warning("Failed to start profiler thread.\n");
+        return false;
+    }
+    
+    running_ = true;
+    return true;
+}
+
+void SamplingProfiler::Stop()
+{
+    if (!running_)
+        return;
+    
+    stop_ = true;
+    pthread_join(thread_, nullptr);
+    running_ = false;
+    
+    Write(path_);
+}
+
+void *SamplingProfiler::ThreadMain(void *param)
+{
+    static_cast<SamplingProfiler *>(param)->Run();
+    return nullptr;
+}
+
+void SamplingProfiler::Run()
+{
+    uintptr_t frames[PROFILE_MAX_DEPTH];
+    uint64_t interval = 1000000000ULL / rate_;
+    uint64_t next = ClockNanos() + interval;
+    
+    while (!stop_)
+    {
+        ClockSleepUntil(next);
+        
+        // Don't try to catch up after this thread was held up
+        uint64_t now = ClockNanos();
+        next += interval;
+        if (next < now)
+            next = now + interval;
+        
+        uint32_t depth = CaptureStack(frames);
+        
+        if (!depth)
+            continue;
+        
+        pthread_mutex_lock(&lock_);
+        
+        Sample &sample = samples_[sampleCount_ % PROFILE_MAX_SAMPLES];
+        sample.depth = depth;
+        memcpy(sample.frames, frames, sizeof(uintptr_t) * depth);
+        sampleCount_++;
+        
+        pthread_mutex_unlock(&lock_);
+    }
+}
+
+uint32_t SamplingProfiler::CaptureStack(uintptr_t *frames)
+{
+    uintptr_t pc, fp;
+    uint32_t depth = 0;
+    kern_return_t kr;
+    
+    // The frame thread could be holding any lock (including malloc's), so nothing between the
+    // suspend and resume may take one
+    if (thread_suspend(target_) != KERN_SUCCESS)
+        return 0;
+    
+#if defined(__x86_64__)
+    x86_thread_state64_t state;
+    mach_msg_type_number_t count = x86_THREAD_STATE64_COUNT;
+    kr = thread_get_state(target_, x86_THREAD_STATE64, (thread_state_t)&state, &count);
+    pc = state.__rip;
+    fp = state.__rbp;
+#else
+    x86_thread_state32_t state;
+    mach_msg_type_number_t count = x86_THREAD_STATE32_COUNT;
+    kr = thread_get_state(target_, x86_THREAD_STATE32, (thread_state_t)&state, &count);
+    pc = state.__eip;
+    fp = state.__ebp;
+#endif
+    
+    if (kr == KERN_SUCCESS)
+    {
+        frames[depth++] = pc;
+        
+        // Each frame starts with the caller's frame pointer followed by the return address. Stop at
+        // anything that doesn't look like a frame on this thread's stack, since code built without
+        // frame pointers leaves garbage in the register.
+        while (depth < PROFILE_MAX_DEPTH && fp >= stackLow_ &&
+               fp <= stackHigh_ - 2 * sizeof(uintptr_t) && (fp & (sizeof(uintptr_t) - 1)) == 0)
+        {
+            const uintptr_t *frame = (const uintptr_t *)fp;
+            
+            if (!frame[1])
+                break;
+            
+            frames[depth++] = frame[1];
+            
+            if (frame[0] <= fp)
+                break;
+            
+            fp = frame[0];
+        }
+    }
+    
+    thread_resume(target_);
+    
+    return depth;
+}
+
+int SamplingProfiler::CompareSamples(const void *a, const void *b)
+{
+    const Sample *sampleA = (const Sample *)a;
+    const Sample *sampleB = (const Sample *)b;
+    
+    if (sampleA->depth != sampleB->depth)
+        return sampleA->depth < sampleB->depth ? -1 : 1;
+    
+    return memcmp(sampleA->frames, sampleB->frames, sizeof(uintptr_t) * sampleA->depth);
+}
+
+bool SamplingProfiler::Write(const char *path)
+{
+    if (!samples_ || !path || !path[0])
+        return false;
+    
+    // Take a copy so the sampler can carry on while the stacks are symbolized
+    pthread_mutex_lock(&lock_);
+    
+    size_t count = sampleCount_ < PROFILE_MAX_SAMPLES ? (size_t)sampleCount_ : PROFILE_MAX_SAMPLES;
+    Sample *copy = (Sample *)malloc(sizeof(Sample) * (count ? count : 1));
+    
+    if (copy)
+        memcpy(copy, samples_, sizeof(Sample) * count);
+    
+    pthread_mutex_unlock(&lock_);
+    
+    if (!copy)
+    {
+        reporter_->Warning("Failed to allocate memory for the profile.\n");
+        return false;
+    }
+    
+    FILE *fp = fopen(path, "w");
+    
+    if (!fp)
+    {
+        reporter_->Warning("Failed to open profile %s: %s\n", path, strerror(errno));
+        free(copy);
+        return false;
+    }
+    
+    // Identical stacks end up next to each other and are written once with their sample count
+    qsort(copy, count, sizeof(Sample), CompareSamples);
+    
+    ProfileSymbolizer symbolizer;
+    
+    for (size_t i = 0; i < count; )
+    {
+        const Sample &sample = copy[i];
+        size_t same = 1;
+        
+        while (i + same < count && CompareSamples(&sample, &copy[i + same]) == 0)
+            same++;
+        
+        // Outermost frame first. Return addresses point after the call, so look up the byte
+        // before them to stay inside the calling function.
+        for (uint32_t frame = sample.depth; frame-- > 0; )
+        {
+            symbolizer.Describe(frame ? sample.frames[frame] - 1 : sample.frames[0], fp);
+            
+            if (frame)
+                fputc(';', fp);
+        }
+        
+        fprintf(fp, " %lu\n", (unsigned long)same);
+        i += same;
+    }
+    
+    free(copy);
+    
+    if (fclose(fp) != 0)
+    {
+        reporter_->Warning("Failed to write profile %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    
+    return true;
+}
@@ -0,0 +1,102 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Game API Library
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_SAMPLINGPROFILER_H_
+#define _INCLUDE_SRCDS_SAMPLINGPROFILER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <mach/mach.h>
+#include "ErrorReporter.h"
+
+// Deepest stack kept for a sample
+#define PROFILE_MAX_DEPTH 48
+
+// Number of samples kept in the ring. Older samples are overwritten once it is full.
+#define PROFILE_MAX_SAMPLES 65536
+
+// Statistical profiler for the server frame thread, taken from the command line:
+//
+//   -profile <file>      Sample the frame thread and write collapsed stacks to file at shutdown
+//   -profilerate <hz>    Samples per second (997 by default)
+//
+// A sampler thread briefly suspends the frame thread, reads its registers and walks its frame
+// pointers into a preallocated ring. Nothing is allocated or locked while the frame thread is
+// stopped. Addresses are only turned into names when the stacks are written, using the hidden
+// symbol tables of the game libraries so functions that aren't exported still get their names.
+// The output can be fed straight to flamegraph.pl.
+class SamplingProfiler
+{
+public:
+    SamplingProfiler(ErrorReporter *reporter);
+    ~SamplingProfiler();
+    
+    void ParseOptions(int argc, char *argv[]);
+    bool IsRunning() const;
+    
+    // Starts sampling the calling thread if -profile was given
+    bool Start();
+    
+    // Stops sampling and writes the -profile file
+    void Stop();
+    
+    // Writes the stacks sampled so far to path. Can be called from any thread while sampling.
+    bool Write(const char *path);
+private:
+    struct Sample
+    {
+        uint32_t depth;
+        uintptr_t frames[PROFILE_MAX_DEPTH];    // Innermost frame first
+    };
+    
+    static void *ThreadMain(void *param);
+    void Run();
+    uint32_t CaptureStack(uintptr_t *frames);
+    static int CompareSamples(const void *a, const void *b);
+private:
+    ErrorReporter *reporter_;
+    char path_[1024];
+    unsigned int rate_;
+    
+    // Frame thread being sampled
+    mach_port_t target_;
+    uintptr_t stackLow_;
+    uintptr_t stackHigh_;
+    
+    pthread_t thread_;
+    bool running_;
+    volatile bool stop_;
+    
+    // Ring of samples, guarded by lock_. sampleCount_ is the total number ever taken.
+    Sample *samples_;
+    uint64_t sampleCount_;
+    pthread_mutex_t lock_;
+};
+
+#endif // _INCLUDE_SRCDS_SAMPLINGPROFILER_H_
@@ -28,6 +28,11 @@
 
 #include "ServerFix.h"
 #include "GameAPI.h"
+#include "DetourStats.h"
+#include "HdrHistogram.h"
+#include "Clock.h"
+#include "FramePacer.h"
+#include "StartupTrace.h"
 
 // From Source SDK: Tells the dedicated server which libraries to load and which interfaces to add
 struct AppSystemInfo_t
@@ -65,6 +70,26 @@ static GameAPI &g_GameAPI = GameAPI::GetInstance();
 static ErrorReporter *g_Reporter;
 static ServerFix *g_ServerFix;
 
+// Number of frames to keep detoured after a command so it gets run. Requested values keep frames
+// detoured until their response arrives (see GameAPI::HasPendingValues).
+static const int kResponseFrames = 2;
+
+// Tick rate used for frame pacing if -tickrate isn't specified (15 ms tick interval)
+static const double kDefaultTickRate = 1.0 / 0.015;
+
+// State of the frame detour. These are shared with the threads that call RequestFrames.
+static volatile int g_ServerStarted;
+static volatile int g_PendingFrames;
+static volatile int g_StopNotified;
+
+// Frame timings
+static HdrHistogram g_RunFrameTimes;
+static HdrHistogram g_GameFrameTimes;
+static HdrHistogram g_ResponseTimes;
+
+// Optional precise frame pacing (-precisepacing)
+static FramePacer g_FramePacer;
+
 // Path to app bundle
 static char *g_AppBundlePath;
 static size_t g_AppBundlePathLen;
@@ -87,9 +112,12 @@ void *LoadModule(const char *pModuleName, int *flags);
 #include <mach-o/dyld.h>
 
 // Detour for function filesystem_stdio or dedicated libraries
+DETOUR_STATS(CBaseFileSystem_AddSearchPath);
 DETOUR_DECL_MEMBER3(CBaseFileSystem_AddSearchPath,
                     void, const char *, pPath, const char *, pPathID, int, addType)
 {
+    DETOUR_PROFILE(CBaseFileSystem_AddSearchPath);
+    
     // Search paths must be adjusted to account for the fact that the program binary is inside an
     // app bundle on OS X (SrcDS.app/Contents/MacOS). This app bundle path must be removed if it
     // exists in the given pPath.
@@ -121,27 +149,39 @@ DETOUR_DECL_MEMBER3(CBaseFileSystem_AddSearchPath,
 }
 
 // Detour for function in tier0 library
+DETOUR_STATS(Plat_DebugString);
 DETOUR_DECL_STATIC1(Plat_DebugString, void, const char *, str)
 {
+    DETOUR_PROFILE(Plat_DebugString);
+    
     // Doing nothing here prevents duplicate message from being printed in the terminal
 }
 
 // Detour for function in launcher library
+DETOUR_STATS(CSDLMgr_Init);
 DETOUR_DECL_MEMBER0(CSDLMgr_Init, int)
 {
+    DETOUR_PROFILE(CSDLMgr_Init);
+    
     // Prevent SDL from initializing to avoid invoking OpenGL
     return 1;
 }
 
 // Detour for function in launcher library
+DETOUR_STATS(CSDLMgr_Shutdown);
 DETOUR_DECL_MEMBER0(CSDLMgr_Shutdown, void)
 {
+    DETOUR_PROFILE(CSDLMgr_Shutdown);
+    
     // Nothing to do here
 }
 
 // Detour for function in dedicated library
+DETOUR_STATS(ConsoleStartup);
 DETOUR_DECL_STATIC1(ConsoleStartup, bool, CreateInterfaceFn, dedicatedFactory)
 {
+    DETOUR_PROFILE(ConsoleStartup);
+    
     // Dispatch GUI events
     g_GameAPI.GetGameListener()->OnGameFrame();
 
@@ -149,75 +189,204 @@ DETOUR_DECL_STATIC1(ConsoleStartup, bool, CreateInterfaceFn, dedicatedFactory)
 }
 
 // Detour for function in dedicated library
+DETOUR_STATS(CSys_ConsoleOutput);
 DETOUR_DECL_MEMBER1(CSys_ConsoleOutput, void, const char *, string)
 {
-    g_GameAPI.GetGameListener()->OnConsoleOutput(string);
+    DETOUR_PROFILE(CSys_ConsoleOutput);
+    
+    IGameListener *listener = g_GameAPI.GetGameListener();
+    ConsoleBatcher *batcher = g_GameAPI.GetConsoleBatcher();
+    
+    // Buffer the output for readers that drain it at their own pace
+    g_GameAPI.GetConsoleRing().Write(string);
+    g_GameAPI.GetLogSink().Write(string);
+    g_GameAPI.GetEventLog().LogConsole(string);
+    
+    // This is only armed for the logs when the listener doesn't want the output
+    if (g_GameAPI.GetUIMode() == UIMode_Console ||
+        !(g_GameAPI.GetEventMask() & GameEvent_ConsoleOutput))
+    {
+        DETOUR_MEMBER_CALL(CSys_ConsoleOutput)(string);
+        return;
+    }
+    
+    if (batcher)
+    {
+        batcher->Append(listener, string);
+        
+        // Only dispatch GUI events when a batch has gone out, not for every message
+        if (!batcher->FlushIfDue(listener, false))
+            return;
+    }
+    else
+    {
+        listener->OnConsoleOutput(string);
+    }
     
     // Dispatch GUI events
-    g_GameAPI.GetGameListener()->OnGameFrame();
+    if (g_GameAPI.GetEventMask() & GameEvent_Frame)
+        listener->OnGameFrame();
 }
 
 // Detour for function in dedicated library
+DETOUR_STATS(ProcessConsoleInput);
 DETOUR_DECL_STATIC0(ProcessConsoleInput, void)
 {
+    DETOUR_PROFILE(ProcessConsoleInput);
+    
     // Nothing to do here
 }
 
 // Detour for function in dedicated library
+DETOUR_STATS(DedicatedSpewOutputFunc);
 DETOUR_DECL_STATIC2(DedicatedSpewOutputFunc, SpewRetval_t, SpewType_t, spewType, const char *, msg)
 {
+    DETOUR_PROFILE(DedicatedSpewOutputFunc);
+    
     if (spewType == SPEW_ERROR)
     {
-        g_GameAPI.GetGameListener()->OnError(msg);
+        IGameListener *listener = g_GameAPI.GetGameListener();
+        ConsoleBatcher *batcher = g_GameAPI.GetConsoleBatcher();
+        
+        // Deliver the output leading up to the error before the process goes away
+        if (batcher)
+            batcher->Flush(listener);
+        
+        listener->OnError(msg);
         return SPEW_ABORT;
     }
     
     return DETOUR_STATIC_CALL(DedicatedSpewOutputFunc)(spewType, msg);
 }
 
+// Checks if frames have to go through the detour even when the listener doesn't want frame events
+static bool FrameDetourRequired()
+{
+    return g_FramePacer.IsEnabled() || g_GameAPI.GetThreadTuning().IsEnabled() ||
+           g_GameAPI.GetConsoleBatcher() != nullptr || g_GameAPI.GetEventLog().IsEnabled() ||
+           StartupTrace::IsRecording() || g_GameAPI.GetProfiler().IsRunning();
+}
+
 // Detour for function in engine library
+DETOUR_STATS(CDedicatedServerAPI_RunFrame);
 DETOUR_DECL_MEMBER0(CDedicatedServerAPI_RunFrame, bool)
 {
-    static bool waiting = true;
+    DETOUR_PROFILE(CDedicatedServerAPI_RunFrame);
+    
     static int count = 0;
+    IGameListener *listener = g_GameAPI.GetGameListener();
+    bool frameEvents = (g_GameAPI.GetEventMask() & GameEvent_Frame) != 0;
     
     // Wait until all the game/engine libraries have been loaded to trigger this
-    if (waiting && ++count == 4)
+    if (!g_ServerStarted && ++count == 4)
     {
-        g_GameAPI.GetGameListener()->OnServerStarted();
-        waiting = false;
+        listener->OnServerStarted();
+        __sync_lock_test_and_set(&g_ServerStarted, 1);
+        StartupTrace::Finish();
     }
     
+    // Start the frame on the next tick deadline. The engine still runs its own millisecond sleep
+    // inside the frame; this only lines up when frames begin.
+    if (g_FramePacer.IsEnabled())
+        g_FramePacer.WaitForNextTick();
+    
+    uint64_t start = ClockNanos();
+    uint64_t gameFrameTime = 0;
+    
     // Run the listener's frame first
-    g_GameAPI.GetGameListener()->OnGameFrame();
+    if (frameEvents)
+    {
+        listener->OnGameFrame();
+        
+        uint64_t now = ClockNanos();
+        gameFrameTime = now - start;
+        start = now;
+    }
     
     // Run original frame
+    ThreadTuning &tuning = g_GameAPI.GetThreadTuning();
+    tuning.BeginFrame();
     bool res = DETOUR_MEMBER_CALL(CDedicatedServerAPI_RunFrame)();
+    tuning.EndFrame();
+    
+    uint64_t end = ClockNanos();
+    uint64_t runFrameTime = end - start;
+    g_RunFrameTimes.Record(runFrameTime);
+    start = end;
+    
+    ConsoleBatcher *batcher = g_GameAPI.GetConsoleBatcher();
     
     if (res == false)
     {
+        if (batcher)
+            batcher->Flush(listener);
+        
+        // Write the profile while the game libraries are still loaded so every sample gets a name
+        g_GameAPI.GetProfiler().Stop();
+        
         // This was the last frame, so notify listener
-        g_GameAPI.GetGameListener()->OnServerStopped();
+        if (__sync_bool_compare_and_swap(&g_StopNotified, 0, 1))
+            listener->OnServerStopped();
+        
         return res;
     }
     
     g_GameAPI.ProcessServerResponses();
     
+    end = ClockNanos();
+    uint64_t responseTime = end - start;
+    g_ResponseTimes.Record(responseTime);
+    start = end;
+    
+    // Deliver the console output of this frame
+    if (batcher)
+        batcher->FlushIfDue(listener, true);
+    
     // Dispatch GUI events
-    g_GameAPI.GetGameListener()->OnGameFrame();
+    if (frameEvents)
+    {
+        listener->OnGameFrame();
+        
+        gameFrameTime += ClockNanos() - start;
+        g_GameFrameTimes.Record(gameFrameTime);
+    }
+    
+    g_GameAPI.GetEventLog().LogFrame(runFrameTime, gameFrameTime, responseTime);
+    
+    // If nothing needs the following frames, let the engine run them without this detour.
+    // The trampoline stays valid, so this is re-armed by RequestFrames() or UpdateEventDetours().
+    int pending = g_PendingFrames;
+    
+    if (pending > 0)
+        __sync_bool_compare_and_swap(&g_PendingFrames, pending, pending - 1);
+    else if (g_ServerStarted && !frameEvents && !FrameDetourRequired() &&
+             !g_GameAPI.HasPendingValues())
+    {
+        runFrame->DisableDetour();
+        
+        // RequestFrames may have raced with the disarm
+        if (g_PendingFrames > 0 || g_GameAPI.HasPendingValues())
+            runFrame->EnableDetour();
+    }
     
     return res;
 }
 
 // Detour for function in filesystem_stdio or dedicated libraries
+DETOUR_STATS(Sys_LoadModuleFlags);
 DETOUR_DECL_STATIC2(Sys_LoadModuleFlags, void *, const char *, pModuleName, int, flags)
 {
+    DETOUR_PROFILE(Sys_LoadModuleFlags);
+    
     return LoadModule(pModuleName, &flags);
 }
 
 // Detour for function in filesystem_stdio or dedicated libraries
+DETOUR_STATS(Sys_LoadModule);
 DETOUR_DECL_STATIC1(Sys_LoadModule, void *, const char *, pModuleName)
 {
+    DETOUR_PROFILE(Sys_LoadModule);
+    
     return LoadModule(pModuleName, nullptr);
 }
 
@@ -226,6 +395,8 @@ void *LoadModule(const char *pModuleName, int *flags)
 {
     void *handle = nullptr;
     
+    TRACE_SCOPE("Sys_LoadModule", pModuleName);
+    
     // Avoid NSAutoreleasepool leaks from libcef
     if (strstr(pModuleName, "chromehtml"))
         return nullptr;
@@ -245,13 +416,17 @@ void *LoadModule(const char *pModuleName, int *flags)
     else
         handle = DETOUR_STATIC_CALL(Sys_LoadModule)(pModuleName);
     
+    TRACE_SCOPE_FAILED(handle == nullptr);
     return handle;
 }
 
 // Detour for function in dedicated library.
 // This detour is particularly important because it sets up many of the other detours above.
+DETOUR_STATS(CSys_LoadModules);
 DETOUR_DECL_MEMBER1(CSys_LoadModules, bool, void *, appsys)
 {
+    DETOUR_PROFILE(CSys_LoadModules);
+    
     typedef void (*AddSystemFunc)(void *, void *, const char *);
     typedef bool (*AddSystemsFunc)(void *, AppSystemInfo_t *);
     typedef void *(*CreateMgrFunc)(void);
@@ -438,8 +613,26 @@ DETOUR_DECL_MEMBER1(CSys_LoadModules, bool, void *, appsys)
     // Set pointer to SDL/Cocoa manager interface in engine to prevent a crash
     *engineManagerInterface = managerInterface;
     
-    // Set up frame detour for GUI mode
-    if (g_GameAPI.GetUIMode() == UIMode_GUI)
+    // Precise frame pacing starts frames on tick deadlines (the engine's own sleep is left alone)
+    ICommandLine *cmdLine = g_GameAPI.GetCommandLine();
+    if (cmdLine->CheckParm("-precisepacing", nullptr))
+    {
+        const char *tickRate = nullptr;
+        double rate = kDefaultTickRate;
+        
+        if (cmdLine->CheckParm("-tickrate", &tickRate) && tickRate && atof(tickRate) > 0.0)
+            rate = atof(tickRate);
+        
+        g_FramePacer.SetTickRate(rate);
+    }
+    
+    // All of the hot libraries have been loaded by now
+    ThreadTuning &tuning = g_GameAPI.GetThreadTuning();
+    tuning.BindLibraries();
+    tuning.LockLibraries();
+    
+    // Set up frame detour for GUI mode or any of the options that need to see frames
+    if (g_GameAPI.GetUIMode() == UIMode_GUI || FrameDetourRequired())
     {
         void *frameFunc = engine.ResolveHiddenSymbol<void *>("_ZN19CDedicatedServerAPI8RunFrameEv");
         if (frameFunc)
@@ -671,6 +864,19 @@ void ServerFix::Initialize(const AString *game, EngineBranch engine)
                              "library\n");
             return;
         }
+        
+        // Disarm detours for events the listener has turned off
+        UpdateEventDetours();
+    }
+    else if (g_GameAPI.GetLogSink().IsEnabled() || g_GameAPI.GetEventLog().IsEnabled())
+    {
+        // The logs need the output in console mode as well
+        consoleOutput = DETOUR_CREATE_MEMBER(CSys_ConsoleOutput, info[3].address);
+        if (consoleOutput)
+            consoleOutput->EnableDetour();
+        else
+            reporter_->Warning("Failed to create detour for CSys::ConsoleOutput. Console output "
+                               "will not be logged.\n");
     }
 
     GameLib tier0("tier0");
@@ -702,16 +908,20 @@ void ServerFix::Shutdown()
     {
         if (consoleStartup)
             consoleStartup->Destroy();
-        if (consoleOutput)
-            consoleOutput->Destroy();
         if (processInput)
             processInput->Destroy();
         if (spewMsg)
             spewMsg->Destroy();
-        if (runFrame)
-            runFrame->Destroy();
     }
     
+    // Detour for GUI mode or the logs
+    if (consoleOutput)
+        consoleOutput->Destroy();
+    
+    // Detour for GUI mode or frame pacing
+    if (runFrame)
+        runFrame->Destroy();
+    
     if (sysLoadModules_)
         sysLoadModules_->Destroy();
     if (loadModule_)
@@ -721,6 +931,48 @@ void ServerFix::Shutdown()
     
 }
 
+void ServerFix::UpdateEventDetours()
+{
+    int events = g_GameAPI.GetEventMask();
+    
+    if (consoleOutput)
+    {
+        if ((events & GameEvent_ConsoleOutput) || g_GameAPI.GetLogSink().IsEnabled() ||
+            g_GameAPI.GetEventLog().IsEnabled())
+            consoleOutput->EnableDetour();
+        else
+            consoleOutput->DisableDetour();
+    }
+    
+    // The frame detour disarms itself once the server has started and frames aren't wanted
+    if (runFrame && ((events & GameEvent_Frame) || FrameDetourRequired()))
+        runFrame->EnableDetour();
+}
+
+void ServerFix::RequestFrames()
+{
+    __sync_lock_test_and_set(&g_PendingFrames, kResponseFrames);
+    
+    if (runFrame)
+        runFrame->EnableDetour();
+}
+
+void ServerFix::NotifyServerStopped()
+{
+    // The last frame is missed when the frame detour was disarmed, i.e. the server was stopped from
+    // its own console while the listener didn't want frame events
+    if (runFrame && __sync_bool_compare_and_swap(&g_StopNotified, 0, 1))
+        g_GameAPI.GetGameListener()->OnServerStopped();
+}
+
+void ServerFix::GetFrameStats(frame_stats_t *stats)
+{
+    g_RunFrameTimes.Snapshot(&stats->runFrame);
+    g_GameFrameTimes.Snapshot(&stats->gameFrame);
+    g_ResponseTimes.Snapshot(&stats->responses);
+    g_FramePacer.GetJitter(&stats->tickJitter);
+}
+
 void ServerFix::SymbolError(const SymbolInfo info[], size_t len, const char *libName)
 {
     AString symbols("");
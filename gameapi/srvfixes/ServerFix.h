@@ -48,6 +48,18 @@ public:
     
     void Initialize(const AString *game, EngineBranch engine);
     void Shutdown();
+    
+    // Arms or disarms the detours that only deliver listener events to match the event mask
+    void UpdateEventDetours();
+    
+    // Keeps server frames detoured for a little while so data responses get processed
+    void RequestFrames();
+    
+    // Sends OnServerStopped after the server has exited if the frame detour didn't see the last frame
+    void NotifyServerStopped();
+    
+    // Snapshots the frame timings recorded by the frame detour
+    void GetFrameStats(frame_stats_t *stats);
 
     void SymbolError(const SymbolInfo info[], size_t len, const char *libName);
 private:
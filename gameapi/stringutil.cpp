@@ -28,9 +28,54 @@
 
 #include "stringutil.h"
 #include <assert.h>
-#include <ctype.h>
 #include <string.h>
 
+// Whitespace as isspace() sees it in the C locale, whatever the current locale is
+static inline bool is_space(char c)
+{
+    return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+// Returns a pointer to the first character that isn't whitespace, which may be the terminator
+static char *skip_space(char *str)
+{
+    while (is_space(*str))
+        str++;
+    
+    return str;
+}
+
+// Returns a pointer to the first whitespace character or the terminator
+static char *find_space(char *str)
+{
+    while (*str && !is_space(*str))
+        str++;
+    
+    return str;
+}
+
+// Returns a pointer to the first |a| or |b| character or the terminator
+static char *find_chars(char *str, char a, char b)
+{
+    while (*str && *str != a && *str != b)
+        str++;
+    
+    return str;
+}
+
+// Copies |length| characters into a buffer of |maxlen| bytes and ensures null termination
+static void copy_range(char *dest, size_t maxlen, const char *src, size_t length)
+{
+    if (!maxlen)
+        return;
+    
+    if (length > maxlen - 1)
+        length = maxlen - 1;
+    
+    memcpy(dest, src, length);
+    dest[length] = '\0';
+}
+
 unsigned int strncopy(char *dest, const char *src, size_t count)
 {
     assert(dest);
@@ -90,11 +135,8 @@ char *strtrim(char *buffer)
     char *start, *end;
     size_t len;
     
-    start = buffer;
-
     // Find the first character that isn't whitespace
-    while (isspace(*start))
-        start++;
+    start = skip_space(buffer);
     
     // Get the length of the string starting from |start|
     len = strlen(start);
@@ -108,7 +150,7 @@ char *strtrim(char *buffer)
     end = &start[len - 1];
     
     // Find the last character that isn't whitespace
-    while (isspace(*end))
+    while (is_space(*end))
         end--;
     
     // Null terminate at the first whitespace character after it
@@ -122,12 +164,23 @@ char *strip_comments(char *buffer)
     assert(buffer);
     
     char *i = buffer;
+    bool quote = false;
     
-    // Find the first instance of two backslashes
-    while (*i != '\0' && *i != '/' && i[1] != '\0' && i[1] != '/')
+    // Find the first instance of two slashes that isn't inside quotes
+    while (*(i = find_chars(i, '/', '"')) != '\0')
+    {
+        if (*i == '"')
+        {
+            quote = !quote;
+        }
+        else if (!quote && i[1] == '/')
+        {
+            *i = '\0';
+            break;
+        }
+        
         i++;
-    
-    *i = '\0';
+    }
     
     return buffer;
 }
@@ -138,80 +191,36 @@ void splitkv(char *buffer, char *keybuf, size_t keylen, char *valuebuf, size_t v
     assert(keybuf);
     assert(valuebuf);
     
-    size_t c, i, len = strlen(buffer);
-    size_t keystart, keyend, valstart, valend;
+    char *keystart, *keyend, *valstart, *valend;
+    char *i = skip_space(buffer);
     bool quote = false;
     
-    for (i = 0; i < len; i++)
-    {
-        if (!isspace(buffer[i]))
-            break;
-    }
-    
-    if (buffer[i] == '"')
+    if (*i == '"')
     {
         quote = true;
         i++;
     }
     
     keystart = i;
+    keyend = i = quote ? find_chars(i, '"', '"') : find_space(i);
     
-    for (; i < len; i++)
-    {
-        if (quote)
-        {
-            if (buffer[i] == '"')
-                break;
-        }
-        else if (isspace(buffer[i]))
-        {
-            break;
-        }
-    }
+    // Step over the closing quote of the key
+    if (quote && *i == '"')
+        i++;
     
-    keyend = i;
+    i = skip_space(i);
     quote = false;
     
-    for (; i < len; i++)
-    {
-        if (!isspace(buffer[i]))
-            break;
-    }
-    
-    if (buffer[i] == '"')
+    if (*i == '"')
     {
         quote = true;
         i++;
     }
     
     valstart = i;
+    valend = quote ? find_chars(i, '"', '"') : find_space(i);
     
-    for (i = valstart; i < len; i++)
-    {
-        if (quote)
-        {
-            if (buffer[i] == '"')
-                break;
-        }
-        else if (isspace(buffer[i]))
-        {
-            break;
-        }
-    }
-    
-    valend = i;
-    
-    // Copy key into key buffer
-    for (c = 0, i = keystart; i < keyend && c < keylen; i++, c++)
-    {
-        keybuf[c] = buffer[i];
-    }
-    keybuf[c] = '\0';
-    
-    // Copy value into value buffer
-    for (c = 0, i = valstart; i < valend && c < valuelen; c++, i++)
-    {
-        valuebuf[c] = buffer[i];
-    }
-    valuebuf[c] = '\0';
+    // Copy key and value into their buffers
+    copy_range(keybuf, keylen, keystart, keyend - keystart);
+    copy_range(valuebuf, valuelen, valstart, valend - valstart);
 }
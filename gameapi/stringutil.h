@@ -45,13 +45,16 @@ size_t strformat(char *buffer, size_t maxlen, const char *fmt, ...);
 // Alternative to vspnrintf that ensure null termination
 size_t strvformat(char *buffer, size_t maxlen, const char *fmt, va_list ap);
 
-// Returns pointer to string with whitespace removed from its left and right sides
+// Returns pointer to string with whitespace removed from its left and right sides.
+// Whitespace is what isspace() matches in the C locale, regardless of the current locale.
 char *strtrim(char *buffer);
 
-// Returns pointer to string with single-line C++ comments (two back slashes) removed
+// Returns pointer to string with single-line C++ comments (two slashes) removed. Slashes inside
+// double quotes don't start a comment.
 char *strip_comments(char *buffer);
 
-// Splits a key/value pair separated by spaces and places them into the given buffers
+// Splits a key/value pair separated by spaces and places them into the given buffers.
+// Either one may be in double quotes. Both buffers are always null terminated.
 void splitkv(char *buffer, char *keybuf, size_t keylen, char *valuebuf, size_t valuelen);
 
 #endif // _INCLUDE_SRCDS_COMMON_STRUTIL_H_
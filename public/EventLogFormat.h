@@ -0,0 +1,90 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#ifndef _INCLUDE_SRCDS_EVENTLOGFORMAT_H_
+#define _INCLUDE_SRCDS_EVENTLOGFORMAT_H_
+
+#include <stdint.h>
+
+// Binary event log written with the -eventlog option and read by the eventlog tool.
+//
+// The log is a header followed by records. Records are aligned to EVENTLOG_ALIGN and never cross
+// a segment boundary; the rest of a segment that a record doesn't fit into is filled with a
+// padding record. A record type of 0 marks the end of the data (the rest of the file is zeros if
+// the server didn't shut down cleanly).
+//
+// Every EVENTLOG_INDEX_INTERVAL bytes, the offset and timestamp of the next record are appended
+// to <log>.idx so readers can jump close to a point in time without scanning the whole log.
+
+#define EVENTLOG_MAGIC              "SRCDSEVT"
+#define EVENTLOG_VERSION            1
+#define EVENTLOG_ALIGN              16
+#define EVENTLOG_SEGMENT_SIZE       (16 * 1024 * 1024)
+#define EVENTLOG_INDEX_INTERVAL     (1024 * 1024)
+
+enum EventLogType
+{
+    EventLog_End,
+    EventLog_Pad,
+    EventLog_Frame,             // eventlog_frame_t
+    EventLog_Console,           // Console output (NUL-terminated)
+    EventLog_SetValue,          // Variable name and value (both NUL-terminated)
+    EventLog_DataUpdated        // OnDataUpdated data (NUL-terminated)
+};
+
+struct eventlog_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t segmentSize;
+    uint64_t startTime;         // Unix time in nanoseconds at which the log was started
+    uint8_t reserved[40];
+};
+
+struct eventlog_record_t
+{
+    uint64_t timestamp;         // Nanoseconds since eventlog_header_t::startTime
+    uint16_t type;              // EventLogType
+    uint16_t reserved;
+    uint32_t length;            // Length of the data that follows, not including padding
+};
+
+struct eventlog_frame_t
+{
+    uint64_t runFrame;          // Nanoseconds spent in the engine's frame
+    uint64_t gameFrame;         // Nanoseconds spent in IGameListener::OnGameFrame
+    uint64_t responses;         // Nanoseconds spent processing server data responses
+};
+
+struct eventlog_index_t
+{
+    uint64_t timestamp;
+    uint64_t offset;
+};
+
+#endif // _INCLUDE_SRCDS_EVENTLOGFORMAT_H_
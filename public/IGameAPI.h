@@ -29,6 +29,7 @@
 #ifndef _INCLUDE_SRCDS_IGAMEAPI_H_
 #define _INCLUDE_SRCDS_IGAMEAPI_H_
 
+#include <stdint.h>
 #include "platform.h"
 #include "am-string.h"
 #include "am-linkedlist.h"
@@ -68,6 +69,15 @@ public:
 
     // Called when a fatal error has a occurred. The program will be terminated afterward.
     virtual void OnError(const char *msg) {}
+    
+    // Called with console output that was gathered over a batching window instead of
+    // OnConsoleOutput (see IGameAPI::SetConsoleBatchWindow). text is NUL-terminated and lineOffsets
+    // holds the offset of each line within it. By default the whole block goes to OnConsoleOutput.
+    virtual void OnConsoleOutputBatch(const char *text, size_t length, const uint32_t *lineOffsets,
+                                      size_t lineCount)
+    {
+        OnConsoleOutput(text);
+    }
 };
 
 enum UIMode
@@ -76,12 +86,117 @@ enum UIMode
     UIMode_GUI                  // Graphical user interface
 };
 
+// Listener events delivered by detouring engine functions. Events that are turned off with
+// IGameAPI::SetEventMask let the engine run its original code without going through a detour.
+enum GameEvent
+{
+    GameEvent_Frame = (1 << 0),         // OnGameFrame, OnValueReceived and OnDataUpdated
+    GameEvent_ConsoleOutput = (1 << 1), // OnConsoleOutput
+
+    GameEvent_All = GameEvent_Frame | GameEvent_ConsoleOutput
+};
+
+// Special windows for IGameAPI::SetConsoleBatchWindow
+#define CONSOLE_BATCH_NONE      0               // Deliver each message with OnConsoleOutput
+#define CONSOLE_BATCH_FRAME     0xFFFFFFFFU     // Gather the output of each server frame
+
+// Buffer size for IGameAPI::ReadConsoleOutput that always fits the next piece of output
+#define CONSOLE_READ_MAX 256
+
+// Position of a reader in the console output (see IGameAPI::ReadConsoleOutput). Zero-initialize it
+// to start at the oldest buffered output.
+struct console_cursor_t
+{
+    uint32_t seq;               // Next piece of output to read
+    uint32_t msg;               // Number of the next message that the reader hasn't started yet
+};
+
 struct game_t
 {
     AString gameDescription;    // User-friendly game name
     AString gameDirectory;      // Directory in which game resides
 };
 
+// Number of lumps in a BSP file
+#define MAP_LUMP_COUNT 64
+
+// Map file information from the BSP header (see IGameAPI::BuildMapCatalogForGame)
+struct map_info_t
+{
+    AString name;               // Map name relative to the maps directory, without .bsp
+    uint64_t fileSize;
+    int64_t modTime;            // Modification time of the file, in seconds since the epoch
+    int version;                // BSP format version, 0 if the file isn't a valid BSP
+    int revision;               // Map revision number
+    uint32_t lumpSizes[MAP_LUMP_COUNT];  // Size of each lump as stored in the file (maybe compressed)
+    int entityCount;            // Number of entities, -1 if the entity lump couldn't be read
+    int spawnPoints;            // Number of info_player_* entities
+};
+
+// A search path from a game's gameinfo.txt (see IGameAPI::BuildSearchPathsForGame)
+struct search_path_t
+{
+    AString pathIds;            // Path IDs the path is added with, i.e. "game+mod"
+    AString path;               // Path as written in gameinfo.txt, i.e. "|gameinfo_path|."
+};
+
+// Number of histogram buckets in detour_stats_t
+#define DETOUR_STATS_BUCKETS 40
+
+// Call statistics for one detoured engine function. These are only collected when the library is
+// built with SRCDS_DETOUR_STATS defined. Times are in CPU time stamp counter (rdtsc) cycles.
+struct detour_stats_t
+{
+    const char *name;           // Name of the detour, i.e. "CDedicatedServerAPI_RunFrame"
+    uint64_t calls;             // Number of times the detour has been called
+    uint64_t totalCycles;       // Total time spent in the detour (including the original function)
+    uint64_t maxCycles;         // Slowest call
+    uint64_t histogram[DETOUR_STATS_BUCKETS];  // Calls that took [2^i, 2^(i+1)) cycles
+};
+
+// Latency percentiles recorded in a histogram, in nanoseconds
+struct hdr_stats_t
+{
+    uint64_t count;             // Number of recorded values
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t p9999;
+    uint64_t max;
+};
+
+// Timings of the parts of a server frame
+struct frame_stats_t
+{
+    hdr_stats_t runFrame;       // The engine's original CDedicatedServerAPI::RunFrame
+    hdr_stats_t gameFrame;      // Both IGameListener::OnGameFrame calls
+    hdr_stats_t responses;      // Processing server data responses
+    hdr_stats_t tickJitter;     // Deviation from the tick interval when using -precisepacing
+};
+
+// Scheduling state of the server frame thread (see the -cpus, -rtprio, -nice and -mlock options)
+struct sched_stats_t
+{
+    char affinity[128];         // CPU list ("0,1") or affinity tag ("tag 3"), "any" if not restricted
+    int policy;                 // SCHED_OTHER, SCHED_FIFO, etc.
+    int priority;               // Scheduling priority within the policy
+    uint64_t lockedBytes;       // Bytes of game library code and data locked with -mlock
+    uint64_t minorFaults;       // Page faults during server frames that didn't need I/O
+    uint64_t majorFaults;       // Page faults during server frames that needed I/O
+    bool threadFaults;          // Fault counts are for the frame thread only, not the whole process
+};
+
+// Console log statistics (see the -consolelog option)
+struct log_stats_t
+{
+    uint64_t bytesWritten;
+    uint64_t bytesDropped;      // Output that was lost because the disk couldn't keep up or failed
+    uint64_t writeErrors;
+    uint32_t rotations;         // Number of times a new log file was started
+    hdr_stats_t flushLatency;   // Time taken by each write to the log file
+};
+
 class IGameAPI
 {
 public:
@@ -118,6 +233,64 @@ public:
     
     // Returns current server frame time
     virtual float GetFrameTime() = 0;
+
+    // Sets which GameEvent flags the listener wants to receive (GameEvent_All by default).
+    // Without GameEvent_Frame, frames are still detoured until the server has started and while
+    // requested values are pending, so OnServerStarted and OnValueReceived keep working.
+    virtual void SetEventMask(int events) = 0;
+    
+    // Copies statistics for up to maxStats detours into stats and returns the number of detours
+    // that have statistics (which may be larger than maxStats). Returns 0 if they aren't compiled in.
+    virtual size_t GetDetourStats(detour_stats_t *stats, size_t maxStats) = 0;
+    
+    // Takes a snapshot of the server frame timings. Frames are only timed while they are detoured
+    // (see SetEventMask).
+    virtual void GetFrameStats(frame_stats_t *stats) = 0;
+    
+    // Returns the scheduling state of the server frame thread. Page faults are only counted when
+    // one of the scheduling options is used.
+    virtual void GetSchedStats(sched_stats_t *stats) = 0;
+    
+    // Delivers OnServerStarted, OnServerStopped, OnValueReceived, OnDataUpdated and OnConsoleOutput
+    // on a separate thread so a slow listener doesn't hold up server frames. The other callbacks
+    // stay on the engine thread. Must be called before RunServer.
+    virtual void SetAsyncEvents(bool enable) = 0;
+    
+    // Reads the console output at *cursor into buffer and advances the cursor. Long messages are
+    // read in several pieces. Returns the length of the piece, or 0 if there's no new output yet or
+    // if it doesn't fit into maxlength (CONSOLE_READ_MAX always does), in which case the cursor
+    // stays on it. Recent output is kept in a fixed-size ring, so a reader that falls too far behind
+    // skips ahead and *dropped is set to the number of messages it missed. Console output is
+    // buffered while OnConsoleOutput events are (see SetEventMask).
+    virtual size_t ReadConsoleOutput(console_cursor_t *cursor, char *buffer, size_t maxlength,
+                                     uint32_t *dropped) = 0;
+    
+    // Gathers console output for the given number of microseconds (or one of the CONSOLE_BATCH_*
+    // values) and delivers it through IGameListener::OnConsoleOutputBatch. With asynchronous events,
+    // all output that is waiting when the delivery thread gets to it forms one batch.
+    virtual void SetConsoleBatchWindow(unsigned int micros) = 0;
+    
+    // Returns statistics for the console log. These are all 0 if it isn't enabled.
+    virtual void GetLogStats(log_stats_t *stats) = 0;
+    
+    // Writes the stacks sampled by the -profile option so far to path in the collapsed format used
+    // by flame graph tools. Returns false if the profiler isn't running or the file can't be written.
+    virtual bool WriteProfile(const char *path) = 0;
+    
+    // Like BuildMapListForGame, but with the information from each map's BSP header. Maps in
+    // subdirectories of the maps directory are included and the list is sorted by name. The results
+    // are kept in .srcds_cache/map_catalog, so only maps that are new or have changed are read
+    // again.
+    virtual void BuildMapCatalogForGame(const char *gameDir, LinkedList<map_info_t> &mapList) = 0;
+    
+    // Returns the search paths in the FileSystem section of a game's gameinfo.txt, in order.
+    // Entries with a conditional that doesn't hold on this platform are left out.
+    virtual void BuildSearchPathsForGame(const char *gameDir, LinkedList<search_path_t> &pathList) = 0;
+    
+    // Delivers batched console output that has waited longer than its window (50 ms with
+    // CONSOLE_BATCH_FRAME). Batches are otherwise only checked when output arrives and at the end of
+    // frames, so call this periodically on the engine thread to deliver output while no frames run.
+    virtual void FlushConsoleOutput() = 0;
 };
 
 // Returns a pointer to the game API interface
@@ -45,6 +45,9 @@ struct CocoaListener;
     // C++ objects
     struct IGameAPI *_api;
     struct CocoaListener *_listener;
+    
+    // Delivers batched console output while the server isn't running frames
+    NSTimer *_batchTimer;
 }
 
 @property (assign, nonatomic) id<SDGameDelegate> delegate;
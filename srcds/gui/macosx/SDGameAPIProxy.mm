@@ -83,6 +83,25 @@ public:
         [[owner_ delegate] onConsoleOutput:@(msg)];
     }
     
+    void OnConsoleOutputBatch(const char *text, size_t length, const uint32_t *lineOffsets,
+                              size_t lineCount)
+    {
+        NSString *str = [[NSString alloc] initWithBytes:text
+                                                 length:length
+                                               encoding:NSUTF8StringEncoding];
+        
+        // A batch can end in the middle of a multibyte character
+        if (str == nil)
+        {
+            str = [[NSString alloc] initWithBytes:text
+                                           length:length
+                                         encoding:NSISOLatin1StringEncoding];
+        }
+        
+        [[owner_ delegate] onConsoleOutput:str];
+        [str release];
+    }
+    
     void OnWarning(const char *msg)
     {
         NSNotificationCenter *defaultCenter = [NSNotificationCenter defaultCenter];
@@ -161,6 +180,9 @@ public:
         _listener = new CocoaListener(self);
 
         _api->SetListener(_listener);
+        
+        // Append console output to the text view once per frame instead of once per message
+        _api->SetConsoleBatchWindow(CONSOLE_BATCH_FRAME);
     }
     return self;
 }
@@ -223,8 +245,25 @@ public:
 - (void)runServerWithDelegate:(id<SDGameDelegate>)delegate
 {
     [self setDelegate:delegate];
+    
+    // Batched console output would otherwise wait for the next frame or message, i.e. while a map
+    // is loading. The server runs on this thread, so the timer fires whenever it pumps events.
+    _batchTimer = [NSTimer timerWithTimeInterval:0.05
+                                          target:self
+                                        selector:@selector(flushConsoleOutput:)
+                                        userInfo:nil
+                                         repeats:YES];
+    [[NSRunLoop currentRunLoop] addTimer:_batchTimer forMode:NSRunLoopCommonModes];
 
     _api->RunServer(UIMode_GUI, *_NSGetArgc(), *_NSGetArgv());
+    
+    [_batchTimer invalidate];
+    _batchTimer = nil;
+}
+
+- (void)flushConsoleOutput:(NSTimer *)timer
+{
+    _api->FlushConsoleOutput();
 }
 
 - (void)stopServer
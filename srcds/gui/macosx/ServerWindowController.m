@@ -459,9 +459,7 @@
 
         [str autorelease];
         
-        // FIXME: When there is a lot of text to output, scrolling after each call to
-        //        OnConsoleOutput() slows the program down considerably. Scrolling should be
-        //        delayed to some later point in time to fix this.
+        // Console output arrives in batches of one frame each, so this only scrolls once per frame
         [consoleView_ scrollRangeToVisible:NSMakeRange([[consoleView_ string] length], 0)];
     }
 }
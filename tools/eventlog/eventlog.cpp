@@ -0,0 +1,262 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * Source Dedicated Server NG - Event Log Reader
+ * Copyright (C) 2011-2013 Scott Ehlert and AlliedModders LLC.
+ * All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "Steamworks SDK," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "EventLogFormat.h"
+
+// Prints the records of an event log written with the server's -eventlog option
+
+static const char *kTypeNames[] =
+{
+    "end",
+    "pad",
+    "frame",
+    "console",
+    "cvar",
+    "data"
+};
+
+static const int kNumTypes = sizeof(kTypeNames) / sizeof(kTypeNames[0]);
+
+static void PrintUsage()
+{
+    printf("Usage: eventlog [options] <file>\n"
+           "\n"
+           "Options:\n"
+           "  -from <seconds>     Skip records before this time (relative to the start of the log)\n"
+           "  -to <seconds>       Stop at records after this time\n"
+           "  -type <type>        Only print frame, console, cvar or data records\n");
+}
+
+static inline uint64_t AlignRecord(uint64_t size)
+{
+    return (size + EVENTLOG_ALIGN - 1) & ~uint64_t(EVENTLOG_ALIGN - 1);
+}
+
+// Uses the sparse index to find a record offset at or before the given time
+static uint64_t FindStartOffset(const char *path, uint64_t from, uint64_t firstRecord)
+{
+    char indexPath[1100];
+    struct stat st;
+    uint64_t offset = firstRecord;
+    
+    snprintf(indexPath, sizeof(indexPath), "%s.idx", path);
+    
+    int fd = open(indexPath, O_RDONLY);
+    if (fd == -1)
+        return offset;
+    
+    if (fstat(fd, &st) == 0 && st.st_size >= off_t(sizeof(eventlog_index_t)))
+    {
+        size_t count = st.st_size / sizeof(eventlog_index_t);
+        eventlog_index_t *index = (eventlog_index_t *)malloc(count * sizeof(eventlog_index_t));
+        
+        if (index && read(fd, index, count * sizeof(eventlog_index_t)) == ssize_t(count * sizeof(eventlog_index_t)))
+        {
+            // Binary search for the last entry that isn't after the start time
+            size_t lo = 0, hi = count;
+            while (lo < hi)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+                if (index[mid].timestamp <= from)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            
+            if (lo > 0)
+                offset = index[lo - 1].offset;
+        }
+        
+        free(index);
+    }
+    
+    close(fd);
+    return offset;
+}
+
+static void PrintRecord(const eventlog_record_t *record)
+{
+    const char *data = (const char *)(record + 1);
+    double seconds = record->timestamp / 1e9;
+    
+    switch (record->type)
+    {
+        case EventLog_Frame:
+            {
+                const eventlog_frame_t *frame = (const eventlog_frame_t *)data;
+                printf("%14.6f  frame    run %.3f ms, game %.3f ms, responses %.3f ms\n", seconds,
+                       frame->runFrame / 1e6, frame->gameFrame / 1e6, frame->responses / 1e6);
+            }
+            break;
+        case EventLog_Console:
+            {
+                // Console output usually ends with its own newline
+                int len = strlen(data);
+                if (len > 0 && data[len - 1] == '\n')
+                    len--;
+                
+                printf("%14.6f  console  %.*s\n", seconds, len, data);
+            }
+            break;
+        case EventLog_SetValue:
+            printf("%14.6f  cvar     %s = \"%s\"\n", seconds, data, data + strlen(data) + 1);
+            break;
+        case EventLog_DataUpdated:
+            printf("%14.6f  data     %s\n", seconds, data);
+            break;
+        default:
+            break;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = nullptr;
+    uint64_t from = 0;
+    uint64_t to = UINT64_MAX;
+    int type = -1;
+    
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-from") == 0 && i + 1 < argc)
+        {
+            from = uint64_t(atof(argv[++i]) * 1e9);
+        }
+        else if (strcmp(argv[i], "-to") == 0 && i + 1 < argc)
+        {
+            to = uint64_t(atof(argv[++i]) * 1e9);
+        }
+        else if (strcmp(argv[i], "-type") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            
+            for (int t = EventLog_Frame; t < kNumTypes; t++)
+            {
+                if (strcmp(name, kTypeNames[t]) == 0)
+                    type = t;
+            }
+            
+            if (type == -1)
+            {
+                fprintf(stderr, "Unknown record type: %s\n", name);
+                return 1;
+            }
+        }
+        else if (argv[i][0] != '-' && !path)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+    
+    if (!path)
+    {
+        PrintUsage();
+        return 1;
+    }
+    
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        perror(path);
+        return 1;
+    }
+    
+    struct stat st;
+    eventlog_header_t header;
+    
+    if (fstat(fd, &st) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, EVENTLOG_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != EVENTLOG_VERSION || header.segmentSize == 0)
+    {
+        fprintf(stderr, "%s is not a valid event log\n", path);
+        close(fd);
+        return 1;
+    }
+    
+    time_t started = time_t(header.startTime / 1000000000);
+    printf("Event log started %s\n", ctime(&started));
+    
+    uint64_t fileSize = st.st_size;
+    uint64_t offset = FindStartOffset(path, from, AlignRecord(sizeof(eventlog_header_t)));
+    bool done = false;
+    
+    // Records never cross segments, so the log can be read one mapped segment at a time
+    while (!done && offset < fileSize)
+    {
+        uint64_t segmentStart = offset - offset % header.segmentSize;
+        size_t length = size_t(fileSize - segmentStart < header.segmentSize ?
+                               fileSize - segmentStart : header.segmentSize);
+        
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, segmentStart);
+        if (mapped == MAP_FAILED)
+        {
+            perror("mmap");
+            break;
+        }
+        
+        const char *segment = (const char *)mapped;
+        size_t pos = size_t(offset - segmentStart);
+        
+        while (pos + sizeof(eventlog_record_t) <= length)
+        {
+            const eventlog_record_t *record = (const eventlog_record_t *)&segment[pos];
+            uint64_t size = AlignRecord(sizeof(eventlog_record_t) + record->length);
+            
+            // Stop at the end of the data, a truncated record or the end of the time range
+            if (record->type == EventLog_End || pos + size > length || record->timestamp > to)
+            {
+                done = true;
+                break;
+            }
+            
+            if (record->timestamp >= from && (type == -1 || record->type == type))
+                PrintRecord(record);
+            
+            pos += size;
+        }
+        
+        munmap(mapped, length);
+        offset = segmentStart + header.segmentSize;
+    }
+    
+    close(fd);
+    return 0;
+}